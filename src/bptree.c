@@ -0,0 +1,360 @@
+#include "bptree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) && !defined(BPTREE_NO_SIMD)
+#include <emmintrin.h>
+#define BPTREE_SIMD 1
+#endif
+
+// 높이의 상한. root가 아닌 내부 노드는 자식이 BPTREE_INNER_MIN + 1개 이상이라 64 level이면 어떤 크기도 넘지 않는다.
+#define BPTREE_MAX_HEIGHT 64
+// 이보다 적어지면 이웃 노드와 합치거나 하나를 빌려 온다.
+#define BPTREE_LEAF_MIN (BPTREE_LEAF_KEYS / 4)
+#define BPTREE_INNER_MIN (BPTREE_INNER_KEYS / 4)
+
+// 루트부터 leaf까지 내려간 경로. index[i]는 nodes[i]에서 내려간 자식 번호
+typedef struct {
+  bptree_inner *nodes[BPTREE_MAX_HEIGHT];
+  uint32_t index[BPTREE_MAX_HEIGHT];
+} bptree_path;
+
+// 정렬된 keys[0..n)에서 key보다 작은 (upper면 key 이하인) key의 수 = 내려갈 자식 번호 / 넣을 자리
+// 4개씩 SIMD로 비교하고, 정렬되어 있으므로 조건이 깨지는 묶음에서 멈춘다.
+static inline uint32_t bptree_rank(const key_t *keys, const uint32_t n, const key_t key, const bool upper){
+  uint32_t i = 0;
+#ifdef BPTREE_SIMD
+  const __m128i k = _mm_set1_epi32(key);
+  for (; i + 4 <= n; i += 4){
+    const __m128i v = _mm_loadu_si128((const __m128i *)(keys + i));
+    // lower: v < key인 lane, upper: v > key가 아닌 lane
+    const int mask = upper ? _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, k))) ^ 0xF
+                           : _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k)));
+    if (mask != 0xF){
+      return i + (uint32_t)__builtin_popcount(mask);
+    }
+  }
+#endif
+  while (i < n && (upper ? keys[i] <= key : keys[i] < key)){
+    i++;
+  }
+  return i;
+}
+
+static void *bptree_node_alloc(const size_t size){
+  // 두 노드 모두 크기가 64의 배수라서 aligned_alloc에 그대로 넘긴다.
+  return aligned_alloc(64, size);
+}
+
+static bptree_leaf *bptree_leaf_alloc(void){
+  bptree_leaf *leaf = (bptree_leaf *)bptree_node_alloc(sizeof(bptree_leaf));
+  if (leaf != NULL){
+    leaf->n = 0;
+    leaf->next = NULL;
+  }
+  return leaf;
+}
+
+bptree *new_bptree(void){
+  bptree *t = (bptree *)calloc(1, sizeof(bptree));
+  if (t == NULL){
+    return NULL;
+  }
+  // 빈 트리도 빈 leaf 하나를 root로 둔다. (root leaf만 비어 있을 수 있음)
+  t->first = bptree_leaf_alloc();
+  if (t->first == NULL){
+    free(t);
+    return NULL;
+  }
+  t->root = t->first;
+  return t;
+}
+
+static void bptree_free_node(void *node, const int height){
+  if (height > 0){
+    bptree_inner *inner = (bptree_inner *)node;
+    for (uint32_t i = 0; i <= inner->n; i++){
+      bptree_free_node(inner->children[i], height - 1);
+    }
+  }
+  free(node);
+}
+
+void delete_bptree(bptree *t){
+  bptree_free_node(t->root, t->height);
+  free(t);
+}
+
+// key가 있을 수 있는 leaf까지 내려간다. upper면 같은 key들의 뒤쪽 (삽입 자리), 아니면 앞쪽
+static bptree_leaf *bptree_descend(const bptree *t, const key_t key, const bool upper, bptree_path *path){
+  void *node = t->root;
+  for (int level = 0; level < t->height; level++){
+    bptree_inner *inner = (bptree_inner *)node;
+    const uint32_t i = bptree_rank(inner->keys, inner->n, key, upper);
+    if (path != NULL){
+      path->nodes[level] = inner;
+      path->index[level] = i;
+    }
+    node = inner->children[i];
+  }
+  return (bptree_leaf *)node;
+}
+
+// 꽉 찬 내부 노드에 (key, right)를 index 자리 다음에 넣으면서 sibling과 둘로 나눈다.
+// 가운데 key는 위로 올라가므로 up_key로 돌려준다.
+static void bptree_inner_split(bptree_inner *inner, bptree_inner *sibling, const uint32_t index, const key_t key,
+                               void *right, key_t *up_key){
+  // 넣은 뒤의 모양을 임시 배열에 만들고 나눈다.
+  key_t keys[BPTREE_INNER_KEYS + 1];
+  void *children[BPTREE_INNER_KEYS + 2];
+  memcpy(keys, inner->keys, index * sizeof(key_t));
+  keys[index] = key;
+  memcpy(keys + index + 1, inner->keys + index, (BPTREE_INNER_KEYS - index) * sizeof(key_t));
+  memcpy(children, inner->children, (index + 1) * sizeof(void *));
+  children[index + 1] = right;
+  memcpy(children + index + 2, inner->children + index + 1, (BPTREE_INNER_KEYS - index) * sizeof(void *));
+
+  const uint32_t left_n = (BPTREE_INNER_KEYS + 1) / 2;
+  inner->n = left_n;
+  memcpy(inner->keys, keys, left_n * sizeof(key_t));
+  memcpy(inner->children, children, (left_n + 1) * sizeof(void *));
+  *up_key = keys[left_n];
+  sibling->n = BPTREE_INNER_KEYS - left_n;
+  memcpy(sibling->keys, keys + left_n + 1, sibling->n * sizeof(key_t));
+  memcpy(sibling->children, children + left_n + 1, (sibling->n + 1) * sizeof(void *));
+}
+
+// key를 하나 추가한다. 같은 key가 있으면 그 뒤에 넣는다. 실패하면 -1
+int bptree_insert(bptree *t, const key_t key){
+  bptree_path path;
+  bptree_leaf *leaf = bptree_descend(t, key, true, &path);
+  uint32_t pos = bptree_rank(leaf->keys, leaf->n, key, true);
+  if (leaf->n < BPTREE_LEAF_KEYS){
+    memmove(leaf->keys + pos + 1, leaf->keys + pos, (leaf->n - pos) * sizeof(key_t));
+    leaf->keys[pos] = key;
+    leaf->n++;
+    t->size++;
+    return 0;
+  }
+
+  // leaf가 꽉 찼으면 나눠야 하고, 위로 꽉 찬 내부 노드가 이어지는 만큼 같이 나뉜다. (root까지 차 있으면 새 root도)
+  // 중간에 할당이 실패해서 반쯤 나뉜 트리가 남지 않도록 필요한 노드를 먼저 모두 할당한다.
+  int splits = 0;
+  while (splits < t->height && path.nodes[t->height - 1 - splits]->n == BPTREE_INNER_KEYS){
+    splits++;
+  }
+  const int count = splits + (splits == t->height);
+  bptree_inner *fresh[BPTREE_MAX_HEIGHT + 1];
+  bptree_leaf *right = bptree_leaf_alloc();
+  for (int i = 0; i < count && right != NULL; i++){
+    fresh[i] = (bptree_inner *)bptree_node_alloc(sizeof(bptree_inner));
+    if (fresh[i] == NULL){
+      while (i-- > 0){
+        free(fresh[i]);
+      }
+      free(right);
+      right = NULL;
+    }
+  }
+  if (right == NULL){
+    return -1;
+  }
+
+  // 뒤쪽 절반을 새 leaf로 옮기고, 새 leaf의 첫 key를 부모에 올린다.
+  const uint32_t mid = (BPTREE_LEAF_KEYS + 1) / 2;
+  right->n = BPTREE_LEAF_KEYS - mid;
+  memcpy(right->keys, leaf->keys + mid, right->n * sizeof(key_t));
+  right->next = leaf->next;
+  leaf->n = mid;
+  leaf->next = right;
+  bptree_leaf *target = pos <= mid ? leaf : right;
+  if (pos > mid){
+    pos -= mid;
+  }
+  memmove(target->keys + pos + 1, target->keys + pos, (target->n - pos) * sizeof(key_t));
+  target->keys[pos] = key;
+  target->n++;
+  t->size++;
+
+  key_t up_key = right->keys[0];
+  void *up_node = right;
+  for (int level = t->height - 1; level >= t->height - splits; level--){
+    bptree_inner *sibling = fresh[t->height - 1 - level];
+    bptree_inner_split(path.nodes[level], sibling, path.index[level], up_key, up_node, &up_key);
+    up_node = sibling;
+  }
+  if (splits == t->height){
+    // root까지 나뉘었으면 새 root를 만든다.
+    bptree_inner *root = fresh[splits];
+    root->n = 1;
+    root->keys[0] = up_key;
+    root->children[0] = t->root;
+    root->children[1] = up_node;
+    t->root = root;
+    t->height++;
+    return 0;
+  }
+  bptree_inner *inner = path.nodes[t->height - 1 - splits];
+  const uint32_t index = path.index[t->height - 1 - splits];
+  memmove(inner->keys + index + 1, inner->keys + index, (inner->n - index) * sizeof(key_t));
+  memmove(inner->children + index + 2, inner->children + index + 1, (inner->n - index) * sizeof(void *));
+  inner->keys[index] = up_key;
+  inner->children[index + 1] = up_node;
+  inner->n++;
+  return 0;
+}
+
+// key와 같은 첫 key를 가리킨다. 없으면 NULL (다음 insert/erase 전까지만 유효)
+// 같은 key가 leaf 경계를 넘어 이어질 수 있으므로 leaf 끝까지 작으면 다음 leaf의 첫 key를 본다.
+const key_t *bptree_find(const bptree *t, const key_t key){
+  const bptree_leaf *leaf = bptree_descend(t, key, false, NULL);
+  uint32_t pos = bptree_rank(leaf->keys, leaf->n, key, false);
+  if (pos == leaf->n){
+    leaf = leaf->next;
+    pos = 0;
+  }
+  return leaf != NULL && leaf->n > 0 && leaf->keys[pos] == key ? &leaf->keys[pos] : NULL;
+}
+
+const key_t *bptree_min(const bptree *t){
+  return t->size > 0 ? &t->first->keys[0] : NULL;
+}
+
+const key_t *bptree_max(const bptree *t){
+  if (t->size == 0){
+    return NULL;
+  }
+  void *node = t->root;
+  for (int level = 0; level < t->height; level++){
+    bptree_inner *inner = (bptree_inner *)node;
+    node = inner->children[inner->n];
+  }
+  const bptree_leaf *leaf = (const bptree_leaf *)node;
+  return &leaf->keys[leaf->n - 1];
+}
+
+// parent의 i번째 key와 i + 1번째 자식을 뺀다.
+static void bptree_inner_remove(bptree_inner *parent, const uint32_t i){
+  memmove(parent->keys + i, parent->keys + i + 1, (parent->n - i - 1) * sizeof(key_t));
+  memmove(parent->children + i + 1, parent->children + i + 2, (parent->n - i - 1) * sizeof(void *));
+  parent->n--;
+}
+
+// 적어진 leaf를 parent의 이웃 leaf와 합치거나 이웃에서 key 하나를 빌려 온다.
+static void bptree_leaf_rebalance(bptree_inner *parent, const uint32_t index){
+  // 오른쪽 이웃이 있으면 (index, index + 1), 없으면 (index - 1, index)를 한 쌍으로 본다.
+  const uint32_t i = index < parent->n ? index : index - 1;
+  bptree_leaf *left = (bptree_leaf *)parent->children[i];
+  bptree_leaf *right = (bptree_leaf *)parent->children[i + 1];
+  if (left->n + right->n <= BPTREE_LEAF_KEYS){
+    memcpy(left->keys + left->n, right->keys, right->n * sizeof(key_t));
+    left->n += right->n;
+    left->next = right->next;
+    free(right);
+    bptree_inner_remove(parent, i);
+    return;
+  }
+  // 합칠 수 없으면 이웃이 충분히 크므로 하나만 옮기고 경계 key를 고친다.
+  if (left->n < right->n){
+    left->keys[left->n++] = right->keys[0];
+    memmove(right->keys, right->keys + 1, (--right->n) * sizeof(key_t));
+  } else {
+    memmove(right->keys + 1, right->keys, right->n * sizeof(key_t));
+    right->keys[0] = left->keys[--left->n];
+    right->n++;
+  }
+  parent->keys[i] = right->keys[0];
+}
+
+// 내부 노드에 대해서도 같은 일을 한다. 합칠 때는 parent의 경계 key가 가운데로 내려온다.
+static void bptree_inner_rebalance(bptree_inner *parent, const uint32_t index){
+  const uint32_t i = index < parent->n ? index : index - 1;
+  bptree_inner *left = (bptree_inner *)parent->children[i];
+  bptree_inner *right = (bptree_inner *)parent->children[i + 1];
+  if (left->n + right->n + 1 <= BPTREE_INNER_KEYS){
+    left->keys[left->n] = parent->keys[i];
+    memcpy(left->keys + left->n + 1, right->keys, right->n * sizeof(key_t));
+    memcpy(left->children + left->n + 1, right->children, (right->n + 1) * sizeof(void *));
+    left->n += right->n + 1;
+    free(right);
+    bptree_inner_remove(parent, i);
+    return;
+  }
+  if (left->n < right->n){
+    left->keys[left->n] = parent->keys[i];
+    left->children[left->n + 1] = right->children[0];
+    left->n++;
+    parent->keys[i] = right->keys[0];
+    memmove(right->keys, right->keys + 1, (right->n - 1) * sizeof(key_t));
+    memmove(right->children, right->children + 1, right->n * sizeof(void *));
+    right->n--;
+  } else {
+    memmove(right->keys + 1, right->keys, right->n * sizeof(key_t));
+    memmove(right->children + 1, right->children, (right->n + 1) * sizeof(void *));
+    right->keys[0] = parent->keys[i];
+    right->children[0] = left->children[left->n];
+    right->n++;
+    parent->keys[i] = left->keys[left->n - 1];
+    left->n--;
+  }
+}
+
+// key 하나를 지운다. 성공하면 0, 없으면 -1
+int bptree_erase(bptree *t, const key_t key){
+  bptree_path path;
+  bptree_leaf *leaf = bptree_descend(t, key, false, &path);
+  uint32_t pos = bptree_rank(leaf->keys, leaf->n, key, false);
+  if (pos == leaf->n){
+    // 같은 key가 다음 leaf에서 시작할 수 있다. 경로도 다음 leaf로 옮긴다.
+    int level = t->height - 1;
+    while (level >= 0 && path.index[level] == path.nodes[level]->n){
+      level--;
+    }
+    if (level < 0){
+      return -1;
+    }
+    path.index[level]++;
+    void *node = path.nodes[level]->children[path.index[level]];
+    for (level++; level < t->height; level++){
+      path.nodes[level] = (bptree_inner *)node;
+      path.index[level] = 0;
+      node = path.nodes[level]->children[0];
+    }
+    leaf = (bptree_leaf *)node;
+    pos = 0;
+  }
+  if (leaf->keys[pos] != key){
+    return -1;
+  }
+  memmove(leaf->keys + pos, leaf->keys + pos + 1, (leaf->n - pos - 1) * sizeof(key_t));
+  leaf->n--;
+  t->size--;
+
+  // 적어진 노드를 아래에서부터 합치거나 채운다. 합치면 부모의 자식이 줄어서 위로 이어질 수 있다.
+  if (t->height > 0 && leaf->n < BPTREE_LEAF_MIN){
+    bptree_leaf_rebalance(path.nodes[t->height - 1], path.index[t->height - 1]);
+    for (int level = t->height - 1; level > 0 && path.nodes[level]->n < BPTREE_INNER_MIN; level--){
+      bptree_inner_rebalance(path.nodes[level - 1], path.index[level - 1]);
+    }
+  }
+  // root에 자식이 하나만 남으면 그 자식이 root가 된다.
+  if (t->height > 0 && ((bptree_inner *)t->root)->n == 0){
+    bptree_inner *root = (bptree_inner *)t->root;
+    t->root = root->children[0];
+    t->height--;
+    free(root);
+  }
+  return 0;
+}
+
+// key를 순서대로 최대 n개 arr에 넣고 넣은 수를 반환한다. leaf를 next로 따라가며 통째로 복사한다.
+size_t bptree_to_array(const bptree *t, key_t *arr, const size_t n){
+  size_t idx = 0;
+  for (const bptree_leaf *leaf = t->first; leaf != NULL && idx < n; leaf = leaf->next){
+    const size_t count = leaf->n < n - idx ? leaf->n : n - idx;
+    memcpy(arr + idx, leaf->keys, count * sizeof(key_t));
+    idx += count;
+  }
+  return idx;
+}
@@ -0,0 +1,49 @@
+#ifndef _BPTREE_H_
+#define _BPTREE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// key를 cache line 단위 노드에 모아 두는 B+tree. rbtree와 같은 key 집합(중복 허용)을 다룬다.
+// 내부 노드는 key 수와 key 15개가 첫 cache line 하나에 들어가서, 한 level을 내려갈 때
+// key line 하나를 SIMD로 비교하고 자식 포인터 하나를 읽는다. (rbtree는 level마다 노드 하나 = cache miss 하나)
+// key는 split/merge 때 노드 사이를 옮겨 다니므로 rbtree의 node_t처럼 오래 들고 있을 handle은 없다.
+#define BPTREE_INNER_KEYS 15
+#define BPTREE_LEAF_KEYS 61
+
+// leaf는 256byte (cache line 4개). key 순서대로 next로 이어져 있어서 순서대로 읽을 때 트리를 다시 내려가지 않는다.
+typedef struct bptree_leaf {
+  _Alignas(64) uint32_t n;
+  key_t keys[BPTREE_LEAF_KEYS];
+  struct bptree_leaf *next;
+} bptree_leaf;
+
+// 내부 노드는 192byte: children[i]의 key <= keys[i] <= children[i + 1]의 key
+typedef struct bptree_inner {
+  _Alignas(64) uint32_t n;  // key 수 (자식은 n + 1개)
+  key_t keys[BPTREE_INNER_KEYS];
+  void *children[BPTREE_INNER_KEYS + 1];
+} bptree_inner;
+
+typedef struct {
+  void *root;          // height가 0이면 leaf, 아니면 bptree_inner
+  int height;          // root부터 leaf 위까지의 내부 노드 level 수
+  bptree_leaf *first;  // 가장 작은 key가 있는 leaf
+  size_t size;         // key 수
+} bptree;
+
+bptree *new_bptree(void);
+void delete_bptree(bptree *);
+
+int bptree_insert(bptree *, const key_t);
+int bptree_erase(bptree *, const key_t);
+
+const key_t *bptree_find(const bptree *, const key_t);
+const key_t *bptree_min(const bptree *);
+const key_t *bptree_max(const bptree *);
+size_t bptree_to_array(const bptree *, key_t *, const size_t);
+
+#endif  // _BPTREE_H_
@@ -0,0 +1,374 @@
+#include "crbtree.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define CRBTREE_MIN_CAPACITY 64
+// parent_color에 31bit만 쓸 수 있으므로 노드 수는 2^31 - 1개까지
+#define CRBTREE_MAX_CAPACITY ((uint32_t)1 << 31)
+
+static inline color_t color_of(const crbtree *t, const uint32_t id){
+  return (color_t)(t->nodes[id].parent_color & 1);
+}
+
+static inline uint32_t parent_of(const crbtree *t, const uint32_t id){
+  return t->nodes[id].parent_color >> 1;
+}
+
+static inline void set_color(crbtree *t, const uint32_t id, const color_t color){
+  t->nodes[id].parent_color = (t->nodes[id].parent_color & ~(uint32_t)1) | color;
+}
+
+static inline void set_parent(crbtree *t, const uint32_t id, const uint32_t parent){
+  t->nodes[id].parent_color = (parent << 1) | (t->nodes[id].parent_color & 1);
+}
+
+crbtree *new_crbtree(void){
+  crbtree *t = (crbtree *)calloc(1, sizeof(crbtree));
+  if (t == NULL){
+    return NULL;
+  }
+  t->nodes = (cnode_t *)calloc(CRBTREE_MIN_CAPACITY, sizeof(cnode_t));
+  if (t->nodes == NULL){
+    free(t);
+    return NULL;
+  }
+  t->capacity = CRBTREE_MIN_CAPACITY;
+  // index 0은 nil 노드 (black)
+  t->used = 1;
+  t->root = CRBTREE_NIL;
+  set_color(t, CRBTREE_NIL, RBTREE_BLACK);
+  return t;
+}
+
+void delete_crbtree(crbtree *t){
+  free(t->nodes);
+  free(t);
+}
+
+// 노드 index 하나를 할당한다. 배열이 가득 차면 두 배로 늘린다. 실패하면 0
+static uint32_t cnode_alloc(crbtree *t){
+  if (t->free_list != CRBTREE_NIL){
+    uint32_t id = t->free_list;
+    t->free_list = t->nodes[id].left;
+    return id;
+  }
+  if (t->used == t->capacity){
+    if (t->capacity == CRBTREE_MAX_CAPACITY){
+      return CRBTREE_NIL;
+    }
+    uint32_t capacity = t->capacity * 2;
+    cnode_t *nodes = (cnode_t *)realloc(t->nodes, (size_t)capacity * sizeof(cnode_t));
+    if (nodes == NULL){
+      return CRBTREE_NIL;
+    }
+    t->nodes = nodes;
+    t->capacity = capacity;
+  }
+  return t->used++;
+}
+
+static void cnode_free(crbtree *t, uint32_t id){
+  t->nodes[id].left = t->free_list;
+  t->free_list = id;
+}
+
+// rbtree.c의 rotate_L과 같음: id를 부모 자리로 올린다. (id는 부모의 오른쪽 자식)
+static void crotate_L(crbtree *t, uint32_t id){
+  cnode_t *nodes = t->nodes;
+  uint32_t parent = parent_of(t, id);
+  uint32_t grand_parent = parent_of(t, parent);
+  uint32_t left = nodes[id].left;
+
+  if (parent == t->root){
+    t->root = id;
+  } else if (nodes[grand_parent].left == parent){
+    nodes[grand_parent].left = id;
+  } else {
+    nodes[grand_parent].right = id;
+  }
+  set_parent(t, id, grand_parent);
+  set_parent(t, parent, id);
+  nodes[id].left = parent;
+  nodes[parent].right = left;
+  set_parent(t, left, parent);
+}
+
+// rbtree.c의 rotate_R과 같음: id를 부모 자리로 올린다. (id는 부모의 왼쪽 자식)
+static void crotate_R(crbtree *t, uint32_t id){
+  cnode_t *nodes = t->nodes;
+  uint32_t parent = parent_of(t, id);
+  uint32_t grand_parent = parent_of(t, parent);
+  uint32_t right = nodes[id].right;
+
+  if (parent == t->root){
+    t->root = id;
+  } else if (nodes[grand_parent].left == parent){
+    nodes[grand_parent].left = id;
+  } else {
+    nodes[grand_parent].right = id;
+  }
+  set_parent(t, id, grand_parent);
+  set_parent(t, parent, id);
+  nodes[id].right = parent;
+  nodes[parent].left = right;
+  set_parent(t, right, parent);
+}
+
+static void insert_fixup(crbtree *t, uint32_t id){
+  cnode_t *nodes = t->nodes;
+  while (id != t->root && color_of(t, parent_of(t, id)) == RBTREE_RED){
+    uint32_t parent = parent_of(t, id);
+    uint32_t grand_parent = parent_of(t, parent);
+    bool is_left = id == nodes[parent].left;
+    bool is_left_parent = parent == nodes[grand_parent].left;
+    uint32_t uncle = is_left_parent ? nodes[grand_parent].right : nodes[grand_parent].left;
+
+    // case 1: 삼촌이 빨간색이면 색만 바꾸고 조부모에서 다시 확인
+    if (color_of(t, uncle) == RBTREE_RED){
+      set_color(t, parent, RBTREE_BLACK);
+      set_color(t, uncle, RBTREE_BLACK);
+      set_color(t, grand_parent, RBTREE_RED);
+      id = grand_parent;
+      continue;
+    }
+    // case 2, 3: 회전 후 끝
+    if (is_left_parent){
+      if (is_left){
+        crotate_R(t, parent);
+        set_color(t, parent, RBTREE_BLACK);
+        set_color(t, nodes[parent].right, RBTREE_RED);
+      } else {
+        crotate_L(t, id);
+        crotate_R(t, id);
+        set_color(t, id, RBTREE_BLACK);
+        set_color(t, nodes[id].right, RBTREE_RED);
+      }
+    } else {
+      if (is_left){
+        crotate_R(t, id);
+        crotate_L(t, id);
+        set_color(t, id, RBTREE_BLACK);
+        set_color(t, nodes[id].left, RBTREE_RED);
+      } else {
+        crotate_L(t, parent);
+        set_color(t, parent, RBTREE_BLACK);
+        set_color(t, nodes[parent].left, RBTREE_RED);
+      }
+    }
+    return;
+  }
+  set_color(t, t->root, RBTREE_BLACK);
+}
+
+// 삽입한 노드의 index를 반환한다. 메모리가 부족하면 0
+uint32_t crbtree_insert(crbtree *t, const key_t key){
+  uint32_t id = cnode_alloc(t);
+  if (id == CRBTREE_NIL){
+    return CRBTREE_NIL;
+  }
+  // node_alloc이 배열을 옮겼을 수 있으므로 nodes는 할당 뒤에 읽는다.
+  cnode_t *nodes = t->nodes;
+  nodes[id].key = key;
+  nodes[id].left = nodes[id].right = CRBTREE_NIL;
+
+  uint32_t parent = CRBTREE_NIL;
+  uint32_t current = t->root;
+  bool is_left = false;
+  while (current != CRBTREE_NIL){
+    parent = current;
+    is_left = key < nodes[current].key;
+    current = is_left ? nodes[current].left : nodes[current].right;
+  }
+  nodes[id].parent_color = (parent << 1) | RBTREE_RED;
+  if (parent == CRBTREE_NIL){
+    t->root = id;
+  } else if (is_left){
+    nodes[parent].left = id;
+  } else {
+    nodes[parent].right = id;
+  }
+  t->size++;
+  insert_fixup(t, id);
+  return id;
+}
+
+uint32_t crbtree_find(const crbtree *t, const key_t key){
+  const cnode_t *nodes = t->nodes;
+  uint32_t current = t->root;
+  while (current != CRBTREE_NIL){
+    if (nodes[current].key == key){
+      return current;
+    }
+    current = key < nodes[current].key ? nodes[current].left : nodes[current].right;
+  }
+  return CRBTREE_NIL;
+}
+
+static uint32_t subtree_min(const crbtree *t, uint32_t id){
+  while (t->nodes[id].left != CRBTREE_NIL){
+    id = t->nodes[id].left;
+  }
+  return id;
+}
+
+static uint32_t subtree_max(const crbtree *t, uint32_t id){
+  while (t->nodes[id].right != CRBTREE_NIL){
+    id = t->nodes[id].right;
+  }
+  return id;
+}
+
+uint32_t crbtree_min(const crbtree *t){
+  return t->root == CRBTREE_NIL ? CRBTREE_NIL : subtree_min(t, t->root);
+}
+
+uint32_t crbtree_max(const crbtree *t){
+  return t->root == CRBTREE_NIL ? CRBTREE_NIL : subtree_max(t, t->root);
+}
+
+// 중위순회 기준 다음 노드, 없으면 0
+uint32_t crbtree_next(const crbtree *t, uint32_t id){
+  if (t->nodes[id].right != CRBTREE_NIL){
+    return subtree_min(t, t->nodes[id].right);
+  }
+  uint32_t parent = parent_of(t, id);
+  while (parent != CRBTREE_NIL && id == t->nodes[parent].right){
+    id = parent;
+    parent = parent_of(t, parent);
+  }
+  return parent;
+}
+
+// 중위순회 기준 이전 노드, 없으면 0
+uint32_t crbtree_prev(const crbtree *t, uint32_t id){
+  if (t->nodes[id].left != CRBTREE_NIL){
+    return subtree_max(t, t->nodes[id].left);
+  }
+  uint32_t parent = parent_of(t, id);
+  while (parent != CRBTREE_NIL && id == t->nodes[parent].left){
+    id = parent;
+    parent = parent_of(t, parent);
+  }
+  return parent;
+}
+
+// rbtree_erase_fixup과 같은 case 구분, 재귀 대신 반복문
+static void erase_fixup(crbtree *t, uint32_t parent, bool is_node_left){
+  cnode_t *nodes = t->nodes;
+  for (;;){
+    uint32_t extra_black = is_node_left ? nodes[parent].left : nodes[parent].right;
+    if (color_of(t, extra_black) == RBTREE_RED){
+      set_color(t, extra_black, RBTREE_BLACK);
+      return;
+    }
+    uint32_t sibling = is_node_left ? nodes[parent].right : nodes[parent].left;
+    // case 1: 형제가 빨간색
+    if (color_of(t, sibling) == RBTREE_RED){
+      if (is_node_left){
+        crotate_L(t, sibling);
+      } else {
+        crotate_R(t, sibling);
+      }
+      set_color(t, sibling, RBTREE_BLACK);
+      set_color(t, parent, RBTREE_RED);
+      continue;
+    }
+    uint32_t near = is_node_left ? nodes[sibling].left : nodes[sibling].right;
+    uint32_t distant = is_node_left ? nodes[sibling].right : nodes[sibling].left;
+    // case 3: 가까운 조카만 빨간색
+    if (color_of(t, near) == RBTREE_RED && color_of(t, distant) == RBTREE_BLACK){
+      if (is_node_left){
+        crotate_R(t, near);
+      } else {
+        crotate_L(t, near);
+      }
+      set_color(t, near, RBTREE_BLACK);
+      set_color(t, sibling, RBTREE_RED);
+      continue;
+    }
+    // case 4: 먼 조카가 빨간색
+    if (color_of(t, distant) == RBTREE_RED){
+      if (is_node_left){
+        crotate_L(t, sibling);
+      } else {
+        crotate_R(t, sibling);
+      }
+      set_color(t, sibling, color_of(t, parent));
+      set_color(t, parent, RBTREE_BLACK);
+      set_color(t, distant, RBTREE_BLACK);
+      return;
+    }
+    // case 2: 형제와 조카가 모두 검은색이면 형제를 빨간색으로 하고 부모로 올라감
+    set_color(t, sibling, RBTREE_RED);
+    if (parent == t->root){
+      return;
+    }
+    is_node_left = nodes[parent_of(t, parent)].left == parent;
+    parent = parent_of(t, parent);
+  }
+}
+
+// u 자리에 v 서브트리를 연결한다. (rbtree.c의 rbtree_transplant와 같음, u의 자식은 건드리지 않음)
+static void transplant(crbtree *t, const uint32_t u, const uint32_t v){
+  cnode_t *nodes = t->nodes;
+  const uint32_t parent = parent_of(t, u);
+  if (u == t->root){
+    t->root = v;
+  } else if (nodes[parent].left == u){
+    nodes[parent].left = v;
+  } else {
+    nodes[parent].right = v;
+  }
+  set_parent(t, v, parent);
+}
+
+// 자식이 둘이면 successor의 key를 복사하지 않고 successor 노드를 id 자리로 옮긴다. (rbtree_erase와 같음)
+// 지우는 노드 말고는 모든 index의 key가 그대로이므로 들고 있던 index는 계속 같은 key를 가리킨다.
+int crbtree_erase(crbtree *t, uint32_t id){
+  cnode_t *nodes = t->nodes;
+  color_t removed_color = color_of(t, id);
+  uint32_t fix_parent;  // 검은색이 하나 모자라게 되는 자리의 부모
+  bool fix_left;
+  if (nodes[id].left == CRBTREE_NIL || nodes[id].right == CRBTREE_NIL){
+    const uint32_t child = nodes[id].left != CRBTREE_NIL ? nodes[id].left : nodes[id].right;
+    fix_parent = id == t->root ? CRBTREE_NIL : parent_of(t, id);
+    fix_left = fix_parent != CRBTREE_NIL && nodes[fix_parent].left == id;
+    transplant(t, id, child);
+  } else {
+    const uint32_t successor = subtree_min(t, nodes[id].right);
+    removed_color = color_of(t, successor);
+    if (parent_of(t, successor) == id){
+      fix_parent = successor;
+      fix_left = false;
+    } else {
+      fix_parent = parent_of(t, successor);
+      fix_left = true;
+      transplant(t, successor, nodes[successor].right);
+      nodes[successor].right = nodes[id].right;
+      set_parent(t, nodes[successor].right, successor);
+    }
+    transplant(t, id, successor);
+    nodes[successor].left = nodes[id].left;
+    set_parent(t, nodes[successor].left, successor);
+    set_color(t, successor, color_of(t, id));
+  }
+  t->size--;
+  cnode_free(t, id);
+
+  if (fix_parent == CRBTREE_NIL){
+    // 루트가 빠졌으면 새 루트만 검은색으로
+    set_color(t, t->root, RBTREE_BLACK);
+  } else if (removed_color == RBTREE_BLACK){
+    erase_fixup(t, fix_parent, fix_left);
+  }
+  return 0;
+}
+
+size_t crbtree_to_array(const crbtree *t, key_t *arr, const size_t n){
+  size_t idx = 0;
+  for (uint32_t id = crbtree_min(t); id != CRBTREE_NIL && idx < n; id = crbtree_next(t, id)){
+    arr[idx++] = t->nodes[id].key;
+  }
+  return idx;
+}
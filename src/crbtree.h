@@ -0,0 +1,45 @@
+#ifndef _CRBTREE_H_
+#define _CRBTREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// 노드를 tree마다 하나의 배열에 두고 32bit index로 연결하는 compact rbtree
+// 노드 하나가 16byte (rbtree의 node_t는 32byte)라서 cache line에 두 배의 노드가 들어간다.
+// 노드는 포인터 대신 index로 가리키며 배열이 커져서 옮겨져도 index는 그대로다. index 0은 nil
+typedef struct {
+  key_t key;
+  uint32_t left, right;
+  uint32_t parent_color;  // (부모 index << 1) | color
+} cnode_t;
+
+typedef struct {
+  cnode_t *nodes;      // nodes[0]은 nil
+  uint32_t root;
+  uint32_t capacity;   // nodes 배열 크기
+  uint32_t used;       // 한 번이라도 할당된 index의 끝
+  uint32_t free_list;  // 삭제된 노드 목록 (left로 연결, 0이면 비어 있음)
+  size_t size;
+} crbtree;
+
+#define CRBTREE_NIL 0
+
+crbtree *new_crbtree(void);
+void delete_crbtree(crbtree *);
+
+uint32_t crbtree_insert(crbtree *, const key_t);
+uint32_t crbtree_find(const crbtree *, const key_t);
+uint32_t crbtree_min(const crbtree *);
+uint32_t crbtree_max(const crbtree *);
+uint32_t crbtree_next(const crbtree *, uint32_t);
+uint32_t crbtree_prev(const crbtree *, uint32_t);
+int crbtree_erase(crbtree *, uint32_t);
+size_t crbtree_to_array(const crbtree *, key_t *, const size_t);
+
+static inline key_t crbtree_key(const crbtree *t, const uint32_t id) {
+  return t->nodes[id].key;
+}
+
+#endif  // _CRBTREE_H_
@@ -1,5 +1,927 @@
 #include "rbtree.h"
+#include "bptree.h"
+#include "rbshard.h"
+#include "rbtree_gen.h"
+
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// rbtree 성능 측정 도구
+//   ./driver -w random,zipf -n 1e3,1e6 -m 1:8:1 -f csv
+//   ./driver -b rbtree,bptree -n 1e6,1e7     (같은 연산 순서를 B+tree에도 적용해서 나란히 비교)
+//   ./driver -b rbtree,gen -n 1e5,2e6        (RBTREE_DEFINE로 만든 int tree와 rbtree.c 비교)
+//   ./driver -b rbshard -j 1,2,4,8 -n 1e7    (rbshard에 thread 수를 늘려 가며 동시에 넣고 찾기)
+// workload와 크기의 조합마다 자식 process에서 따로 돌려서 peak RSS가 섞이지 않게 한다.
+
+// pq: timer/작업 queue처럼 pop_min + push와 key 변경을 binary heap과 비교한다.
+typedef enum { WL_RANDOM, WL_SORTED, WL_REVERSE, WL_ZIPF, WL_DUP, WL_PQ, WL_COUNT } workload_t;
+
+static const char *workload_names[WL_COUNT] = {"random", "sorted", "reverse", "zipf", "dup", "pq"};
+
+// 측정할 자료구조. rbtree가 아니면 phase 이름 앞에 이름을 붙인다. (예: bptree_find)
+// gen은 rbtree_gen.h로 찍어낸 int tree라서 rbtree.c와 같은 알고리즘의 inline 버전을 잰다.
+// rbshard는 -j로 준 수의 thread가 같이 넣고 찾는다. (phase 이름에 thread 수를 붙임, 예: rbshard_j4_build)
+typedef enum { BE_RBTREE, BE_BPTREE, BE_GEN, BE_RBSHARD, BE_COUNT } backend_t;
+
+static const char *backend_names[BE_COUNT] = {"rbtree", "bptree", "gen", "rbshard"};
+
+RBTREE_DEFINE(gen, key_t, a < b)
+
+typedef enum { FMT_TEXT, FMT_CSV, FMT_JSON } format_t;
+
+typedef struct {
+  workload_t workload;
+  backend_t backend;
+  size_t n;               // 처음에 넣는 key 수
+  size_t ops;             // 섞인 연산 수 (0이면 n)
+  unsigned int mix[3];    // insert:find:erase 비율
+  uint64_t seed;
+  size_t threads;         // rbshard를 같이 쓰는 thread 수
+  format_t format;
+  const char *tag;        // 결과 줄마다 붙이는 이름 (예: commit hash)
+} bench_config;
+
+// ---- 난수 ----
+
+// splitmix64: seed 하나로 j번째 값을 바로 계산할 수 있어서 넣었던 key를 저장하지 않고 다시 만든다.
+static uint64_t mix64(uint64_t x){
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+typedef struct {
+  uint64_t state;
+} rng_t;
+
+static uint64_t rng_next(rng_t *r){
+  r->state += 0x9e3779b97f4a7c15ull;
+  return mix64(r->state);
+}
+
+static double rng_unit(rng_t *r){
+  return (rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// YCSB와 같은 Zipf 분포 (theta = 0.99). 0이 가장 자주 나오는 rank
+typedef struct {
+  size_t n;
+  double theta, alpha, zetan, eta, half_pow;
+} zipf_t;
+
+static void zipf_init(zipf_t *z, const size_t n){
+  z->n = n;
+  z->theta = 0.99;
+  z->zetan = 0;
+  for (size_t i = 1; i <= n; i++){
+    z->zetan += 1.0 / pow((double)i, z->theta);
+  }
+  const double zeta2 = 1.0 + pow(0.5, z->theta);
+  z->alpha = 1.0 / (1.0 - z->theta);
+  z->eta = (1.0 - pow(2.0 / n, 1.0 - z->theta)) / (1.0 - zeta2 / z->zetan);
+  z->half_pow = pow(0.5, z->theta);
+}
+
+static size_t zipf_next(const zipf_t *z, rng_t *r){
+  const double u = rng_unit(r);
+  const double uz = u * z->zetan;
+  if (uz < 1.0){
+    return 0;
+  }
+  if (uz < 1.0 + z->half_pow){
+    return 1;
+  }
+  size_t rank = (size_t)(z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+  return rank < z->n ? rank : z->n - 1;
+}
+
+// ---- workload별 key ----
+
+typedef struct {
+  const bench_config *config;
+  rng_t rng;
+  zipf_t zipf;
+  size_t inserted;  // 지금까지 insert에 쓴 key 수
+} keygen_t;
+
+// j번째로 넣는 key
+static key_t insert_key(keygen_t *g, const size_t j){
+  switch (g->config->workload){
+  case WL_SORTED:
+    return (key_t)j;
+  case WL_REVERSE:
+    return (key_t)(-(int64_t)j);
+  case WL_ZIPF:
+    // 자주 나오는 rank가 key 공간에 흩어지도록 섞는다.
+    return (key_t)mix64(g->config->seed ^ zipf_next(&g->zipf, &g->rng));
+  case WL_DUP:
+    // key마다 평균 64번 중복
+    return (key_t)(mix64(g->config->seed + j) % (g->config->n / 64 + 1));
+  default:
+    return (key_t)mix64(g->config->seed + j);
+  }
+}
+
+// key에 delta를 더한다. key가 INT_MIN/INT_MAX 근처일 수 있으므로 64bit로 계산하고 key_t 범위로 자른다.
+static key_t key_shift(const key_t key, const int64_t delta){
+  const int64_t shifted = (int64_t)key + delta;
+  return shifted < INT_MIN ? INT_MIN : shifted > INT_MAX ? INT_MAX : (key_t)shifted;
+}
+
+// find/erase에 쓰는 key: 이미 넣었던 key 중 하나 (zipf는 같은 분포에서 새로 뽑는다)
+static key_t lookup_key(keygen_t *g){
+  if (g->config->workload == WL_ZIPF || g->inserted == 0){
+    return insert_key(g, 0);
+  }
+  return insert_key(g, rng_next(&g->rng) % g->inserted);
+}
+
+// ---- latency histogram ----
+
+// 16 미만은 1ns 단위, 그 위는 2의 거듭제곱 구간마다 16칸 (오차 6% 이내)
+// 연산 수와 상관없이 메모리가 일정하다.
+#define HIST_SUB 16
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+typedef struct {
+  uint64_t count[HIST_BUCKETS];
+  uint64_t total;
+  uint64_t sum_ns;
+} histogram_t;
+
+static size_t hist_bucket(const uint64_t ns){
+  if (ns < HIST_SUB){
+    return (size_t)ns;
+  }
+  const int e = 63 - __builtin_clzll(ns);
+  return (size_t)(e - 3) * HIST_SUB + ((ns >> (e - 4)) & (HIST_SUB - 1));
+}
+
+static uint64_t hist_bucket_value(const size_t b){
+  if (b < HIST_SUB){
+    return b;
+  }
+  const int e = (int)(b / HIST_SUB) + 3;
+  return (uint64_t)(HIST_SUB + b % HIST_SUB) << (e - 4);
+}
+
+static void hist_add(histogram_t *h, const uint64_t ns){
+  h->count[hist_bucket(ns)]++;
+  h->total++;
+  h->sum_ns += ns;
+}
+
+// count개의 연산이 같은 latency를 가진 것으로 센다. (묶음으로 잰 연산의 평균)
+static void hist_add_many(histogram_t *h, const uint64_t ns, const uint64_t count){
+  h->count[hist_bucket(ns)] += count;
+  h->total += count;
+  h->sum_ns += ns * count;
+}
+
+static uint64_t hist_percentile(const histogram_t *h, const double p){
+  const uint64_t rank = (uint64_t)ceil(p * h->total);
+  uint64_t seen = 0;
+  for (size_t b = 0; b < HIST_BUCKETS; b++){
+    seen += h->count[b];
+    if (seen >= rank && seen > 0){
+      return hist_bucket_value(b);
+    }
+  }
+  return 0;
+}
+
+// ---- 측정 ----
+
+static uint64_t now_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static long peak_rss_kb(void){
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+static void print_header(const format_t format){
+  if (format == FMT_CSV){
+    printf("tag,workload,n,phase,ops,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns,peak_rss_kb\n");
+  } else if (format == FMT_TEXT){
+    printf("%-10s %-8s %10s %-13s %10s %9s %12s %7s %7s %8s %12s\n", "tag", "workload", "n", "phase", "ops", "seconds",
+           "ops/sec", "p50ns", "p99ns", "p999ns", "peak_rss_kb");
+  }
+}
+
+// 결과 한 줄. 시간에는 연산마다 잰 clock_gettime 비용(수십 ns)이 포함된다.
+static void report(const bench_config *c, const char *phase, const histogram_t *h, const uint64_t elapsed_ns){
+  if (h->total == 0){
+    return;
+  }
+  const double seconds = elapsed_ns / 1e9;
+  const double throughput = seconds > 0 ? h->total / seconds : 0;
+  const char *tag = c->tag != NULL ? c->tag : "-";
+  const char *workload = workload_names[c->workload];
+  char name[32];
+  if (c->backend == BE_RBSHARD){
+    snprintf(name, sizeof(name), "%s_j%zu_%s", backend_names[c->backend], c->threads, phase);
+    phase = name;
+  } else if (c->backend != BE_RBTREE){
+    snprintf(name, sizeof(name), "%s_%s", backend_names[c->backend], phase);
+    phase = name;
+  }
+  const unsigned long long p50 = hist_percentile(h, 0.50);
+  const unsigned long long p99 = hist_percentile(h, 0.99);
+  const unsigned long long p999 = hist_percentile(h, 0.999);
+  const long rss = peak_rss_kb();
+  switch (c->format){
+  case FMT_CSV:
+    printf("%s,%s,%zu,%s,%llu,%.6f,%.0f,%llu,%llu,%llu,%ld\n", tag, workload, c->n, phase,
+           (unsigned long long)h->total, seconds, throughput, p50, p99, p999, rss);
+    break;
+  case FMT_JSON:
+    printf("{\"tag\":\"%s\",\"workload\":\"%s\",\"n\":%zu,\"phase\":\"%s\",\"ops\":%llu,\"seconds\":%.6f,"
+           "\"ops_per_sec\":%.0f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"peak_rss_kb\":%ld}\n",
+           tag, workload, c->n, phase, (unsigned long long)h->total, seconds, throughput, p50, p99, p999, rss);
+    break;
+  default:
+    printf("%-10s %-8s %10zu %-13s %10llu %9.3f %12.0f %7llu %7llu %8llu %12ld\n", tag, workload, c->n, phase,
+           (unsigned long long)h->total, seconds, throughput, p50, p99, p999, rss);
+  }
+}
+
+// ---- priority queue 비교용 binary heap ----
+
+// handle(0..n-1)마다 heap 안의 위치를 기억해서 key 변경도 O(log n)에 한다.
+typedef struct {
+  key_t *keys;      // heap 순서의 key
+  size_t *handles;  // heap 위치 -> handle
+  size_t *pos;      // handle -> heap 위치
+  size_t size;
+} heap_t;
+
+static void heap_swap(heap_t *h, const size_t i, const size_t j){
+  const key_t key = h->keys[i];
+  h->keys[i] = h->keys[j];
+  h->keys[j] = key;
+  const size_t handle = h->handles[i];
+  h->handles[i] = h->handles[j];
+  h->handles[j] = handle;
+  h->pos[h->handles[i]] = i;
+  h->pos[h->handles[j]] = j;
+}
+
+static void heap_sift(heap_t *h, size_t i){
+  while (i > 0 && h->keys[i] < h->keys[(i - 1) / 2]){
+    heap_swap(h, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  for (;;){
+    size_t smallest = i;
+    const size_t l = 2 * i + 1, r = 2 * i + 2;
+    if (l < h->size && h->keys[l] < h->keys[smallest]){
+      smallest = l;
+    }
+    if (r < h->size && h->keys[r] < h->keys[smallest]){
+      smallest = r;
+    }
+    if (smallest == i){
+      return;
+    }
+    heap_swap(h, i, smallest);
+    i = smallest;
+  }
+}
+
+static void heap_push(heap_t *h, const size_t handle, const key_t key){
+  h->keys[h->size] = key;
+  h->handles[h->size] = handle;
+  h->pos[handle] = h->size;
+  h->size++;
+  heap_sift(h, h->size - 1);
+}
+
+static size_t heap_pop_min(heap_t *h, key_t *key){
+  const size_t handle = h->handles[0];
+  *key = h->keys[0];
+  heap_swap(h, 0, --h->size);
+  heap_sift(h, 0);
+  return handle;
+}
+
+static void heap_update(heap_t *h, const size_t handle, const key_t key){
+  h->keys[h->pos[handle]] = key;
+  heap_sift(h, h->pos[handle]);
+}
+
+// 같은 연산 순서를 rbtree와 heap에 각각 적용해서 잰다.
+//   build: n개 넣기, update: 임의의 원소의 key를 조금 줄이기 (decrease-key),
+//   pop_push: 최소값을 꺼내고 조금 뒤의 key로 다시 넣기 (timer hold model)
+static int run_pq_bench(const bench_config *c){
+  const size_t n = c->n;
+  const size_t ops = c->ops > 0 ? c->ops : n;
+  keygen_t g = {c, {c->seed}, {0}, 0};
+  histogram_t *h = (histogram_t *)calloc(2, sizeof(histogram_t));
+  node_t **nodes = (node_t **)malloc(n * sizeof(node_t *));
+  heap_t heap = {(key_t *)malloc(n * sizeof(key_t)), (size_t *)malloc(n * sizeof(size_t)),
+                 (size_t *)malloc(n * sizeof(size_t)), 0};
+  rbtree *t = new_rbtree();
+  if (h == NULL || nodes == NULL || heap.keys == NULL || heap.handles == NULL || heap.pos == NULL || t == NULL){
+    fprintf(stderr, "driver: out of memory\n");
+    return 1;
+  }
+
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++){
+    const key_t key = insert_key(&g, i);
+    const uint64_t begin = now_ns();
+    nodes[i] = rbtree_insert(t, key);
+    hist_add(&h[0], now_ns() - begin);
+  }
+  uint64_t elapsed = now_ns() - start;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++){
+    const key_t key = insert_key(&g, i);
+    const uint64_t begin = now_ns();
+    heap_push(&heap, i, key);
+    hist_add(&h[1], now_ns() - begin);
+  }
+  report(c, "build", &h[0], elapsed);
+  report(c, "heap_build", &h[1], now_ns() - start);
+
+  const rng_t saved = g.rng;
+  memset(h, 0, 2 * sizeof(histogram_t));
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++){
+    node_t *node = nodes[rng_next(&g.rng) % n];
+    const key_t key = key_shift(node->key, -(int64_t)(rng_next(&g.rng) % 1024));
+    const uint64_t begin = now_ns();
+    rbtree_update_key(t, node, key);
+    hist_add(&h[0], now_ns() - begin);
+  }
+  elapsed = now_ns() - start;
+  g.rng = saved;
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++){
+    const size_t handle = rng_next(&g.rng) % n;
+    const key_t key = key_shift(heap.keys[heap.pos[handle]], -(int64_t)(rng_next(&g.rng) % 1024));
+    const uint64_t begin = now_ns();
+    heap_update(&heap, handle, key);
+    hist_add(&h[1], now_ns() - begin);
+  }
+  report(c, "update", &h[0], elapsed);
+  report(c, "heap_update", &h[1], now_ns() - start);
+
+  // 꺼낸 노드는 해제되므로 이 단계부터 nodes는 쓰지 않는다.
+  const rng_t saved_pop = g.rng;
+  memset(h, 0, 2 * sizeof(histogram_t));
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++){
+    const int64_t delay = (int64_t)(rng_next(&g.rng) % (1 << 20));
+    const uint64_t begin = now_ns();
+    key_t key;
+    rbtree_pop_min(t, &key);
+    rbtree_insert(t, key_shift(key, delay));
+    hist_add(&h[0], now_ns() - begin);
+  }
+  elapsed = now_ns() - start;
+  g.rng = saved_pop;
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++){
+    const int64_t delay = (int64_t)(rng_next(&g.rng) % (1 << 20));
+    const uint64_t begin = now_ns();
+    key_t key;
+    const size_t handle = heap_pop_min(&heap, &key);
+    heap_push(&heap, handle, key_shift(key, delay));
+    hist_add(&h[1], now_ns() - begin);
+  }
+  report(c, "pop_push", &h[0], elapsed);
+  report(c, "heap_pop_push", &h[1], now_ns() - start);
+
+  delete_rbtree(t);
+  free(heap.keys);
+  free(heap.handles);
+  free(heap.pos);
+  free(nodes);
+  free(h);
+  return 0;
+}
+
+// ---- 측정 대상 ----
+
+// run_bench는 backend와 상관없이 key 값으로 넣고 찾고 지운다. (분기는 backend마다 항상 같은 쪽이라 예측됨)
+typedef struct {
+  backend_t backend;
+  rbtree *rb;
+  bptree *bp;
+  gen_tree *gen;
+} bench_tree;
+
+static bool tree_open(bench_tree *t, const backend_t backend){
+  t->backend = backend;
+  t->rb = backend == BE_RBTREE ? new_rbtree() : NULL;
+  t->bp = backend == BE_BPTREE ? new_bptree() : NULL;
+  t->gen = backend == BE_GEN ? gen_new() : NULL;
+  return t->rb != NULL || t->bp != NULL || t->gen != NULL;
+}
+
+static void tree_close(bench_tree *t){
+  if (t->rb != NULL){
+    delete_rbtree(t->rb);
+  }
+  if (t->bp != NULL){
+    delete_bptree(t->bp);
+  }
+  if (t->gen != NULL){
+    gen_delete(t->gen);
+  }
+}
+
+static void tree_insert(bench_tree *t, const key_t key){
+  if (t->backend == BE_BPTREE){
+    bptree_insert(t->bp, key);
+  } else if (t->backend == BE_GEN){
+    gen_insert(t->gen, key);
+  } else {
+    rbtree_insert(t->rb, key);
+  }
+}
+
+static bool tree_find(bench_tree *t, const key_t key){
+  if (t->backend == BE_BPTREE){
+    return bptree_find(t->bp, key) != NULL;
+  }
+  if (t->backend == BE_GEN){
+    return gen_find(t->gen, key) != NULL;
+  }
+  return rbtree_find(t->rb, key) != NULL;
+}
+
+static void tree_erase(bench_tree *t, const key_t key){
+  if (t->backend == BE_BPTREE){
+    bptree_erase(t->bp, key);
+    return;
+  }
+  if (t->backend == BE_GEN){
+    gen_node_t *node = gen_find(t->gen, key);
+    if (node != NULL){
+      gen_erase(t->gen, node);
+    }
+    return;
+  }
+  node_t *node = rbtree_find(t->rb, key);
+  if (node != NULL){
+    rbtree_erase(t->rb, node);
+  }
+}
+
+static size_t tree_size(const bench_tree *t){
+  if (t->backend == BE_GEN){
+    return t->gen->size;
+  }
+  return t->backend == BE_BPTREE ? t->bp->size : t->rb->size;
+}
+
+static size_t tree_to_array(bench_tree *t, key_t *arr, const size_t n){
+  if (t->backend == BE_BPTREE){
+    return bptree_to_array(t->bp, arr, n);
+  }
+  if (t->backend == BE_GEN){
+    return gen_to_array(t->gen, arr, n);
+  }
+  return (size_t)rbtree_to_array(t->rb, arr, n);
+}
+
+// ---- rbshard: 여러 thread ----
+
+// thread 수만 바꿔 가며 비교하도록 shard 수는 고정한다. (thread보다 충분히 많아서 lock을 기다리는 일이 드묾)
+#define SHARD_COUNT 64
+
+typedef struct {
+  const bench_config *config;
+  rbshard *shard;
+  const zipf_t *zipf;
+  size_t index;          // thread 번호 (0..threads-1)
+  int phase;             // 0: build, 1: mixed
+  volatile size_t found;
+  histogram_t h[4];      // build, mixed의 insert, find, erase
+} shard_worker;
+
+// build는 j번째 key를 j % threads번 thread가 넣는다. mixed는 thread마다 ops / threads개를 섞어서 하고
+// 새로 넣는 key는 n 뒤의 번호를 같은 방식으로 나눠 쓴다. 찾고 지우는 key는 build에서 넣은 key 중 하나
+static void *shard_worker_run(void *arg){
+  shard_worker *w = (shard_worker *)arg;
+  const bench_config *c = w->config;
+  const size_t threads = c->threads;
+  keygen_t g = {c, {c->seed ^ mix64(w->index + 1)}, *w->zipf, c->n};
+  if (w->phase == 0){
+    for (size_t j = w->index; j < c->n; j += threads){
+      const key_t key = insert_key(&g, j);
+      const uint64_t begin = now_ns();
+      rbshard_insert(w->shard, key);
+      hist_add(&w->h[0], now_ns() - begin);
+    }
+    return NULL;
+  }
+  const unsigned int total_weight = c->mix[0] + c->mix[1] + c->mix[2];
+  const size_t ops = (c->ops > 0 ? c->ops : c->n) / threads;
+  size_t next = c->n + w->index;
+  for (size_t i = 0; i < ops && total_weight > 0; i++){
+    const unsigned int pick = rng_next(&g.rng) % total_weight;
+    if (pick < c->mix[0]){
+      const key_t key = insert_key(&g, next);
+      next += threads;
+      const uint64_t begin = now_ns();
+      rbshard_insert(w->shard, key);
+      hist_add(&w->h[1], now_ns() - begin);
+    } else if (pick < c->mix[0] + c->mix[1]){
+      const key_t key = lookup_key(&g);
+      const uint64_t begin = now_ns();
+      w->found += rbshard_contains(w->shard, key);
+      hist_add(&w->h[2], now_ns() - begin);
+    } else {
+      const key_t key = lookup_key(&g);
+      const uint64_t begin = now_ns();
+      rbshard_erase(w->shard, key);
+      hist_add(&w->h[3], now_ns() - begin);
+    }
+  }
+  return NULL;
+}
+
+// phase를 모든 thread에서 동시에 돌리고 끝날 때까지 걸린 시간을 돌려준다. thread를 만들지 못하면 0
+static uint64_t shard_run_phase(shard_worker *workers, const size_t threads, const int phase){
+  pthread_t *ids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+  if (ids == NULL){
+    return 0;
+  }
+  const uint64_t start = now_ns();
+  size_t started = 0;
+  for (; started < threads; started++){
+    workers[started].phase = phase;
+    if (pthread_create(&ids[started], NULL, shard_worker_run, &workers[started]) != 0){
+      break;
+    }
+  }
+  for (size_t i = 0; i < started; i++){
+    pthread_join(ids[i], NULL);
+  }
+  const uint64_t elapsed = now_ns() - start;
+  free(ids);
+  return started == threads ? elapsed : 0;
+}
+
+// thread들의 histogram을 into에 더한다.
+static void hist_merge(histogram_t *into, const histogram_t *h){
+  for (size_t b = 0; b < HIST_BUCKETS; b++){
+    into->count[b] += h->count[b];
+  }
+  into->total += h->total;
+  into->sum_ns += h->sum_ns;
+}
+
+// run_bench와 같은 build, mixed, scan 단계를 threads개의 thread로 잰다.
+// 처리량은 전체 연산 수를 벽시계 시간으로 나눈 값이므로 thread 수에 따른 확장을 그대로 보여 준다.
+static int run_shard_bench(const bench_config *c){
+  zipf_t zipf = {0};
+  if (c->workload == WL_ZIPF){
+    zipf_init(&zipf, c->n);
+  }
+  const size_t threads = c->threads;
+  rbshard *shard = new_rbshard(SHARD_COUNT);
+  shard_worker *workers = (shard_worker *)calloc(threads, sizeof(shard_worker));
+  histogram_t *h = (histogram_t *)calloc(5, sizeof(histogram_t));
+  if (shard == NULL || workers == NULL || h == NULL){
+    fprintf(stderr, "driver: out of memory\n");
+    return 1;
+  }
+  for (size_t i = 0; i < threads; i++){
+    workers[i].config = c;
+    workers[i].shard = shard;
+    workers[i].zipf = &zipf;
+    workers[i].index = i;
+  }
+
+  const uint64_t build_ns = shard_run_phase(workers, threads, 0);
+  if (build_ns == 0){
+    fprintf(stderr, "driver: cannot start threads\n");
+    return 1;
+  }
+  // sorted처럼 key가 한 구간에 몰리는 workload도 thread들이 여러 shard에 나뉘도록 mixed 전에 경계를 다시 정한다.
+  histogram_t rebalance = {{0}, 0, 0};
+  uint64_t begin = now_ns();
+  rbshard_rebalance(shard);
+  hist_add(&rebalance, now_ns() - begin);
+  const uint64_t mixed_ns = shard_run_phase(workers, threads, 1);
+  if (mixed_ns == 0){
+    fprintf(stderr, "driver: cannot start threads\n");
+    return 1;
+  }
+  for (size_t i = 0; i < threads; i++){
+    for (int k = 0; k < 4; k++){
+      hist_merge(&h[k], &workers[i].h[k]);
+    }
+  }
+  report(c, "build", &h[0], build_ns);
+  report(c, "rebalance", &rebalance, rebalance.sum_ns);
+  histogram_t all = {{0}, 0, 0};
+  for (int k = 1; k <= 3; k++){
+    hist_merge(&all, &h[k]);
+  }
+  report(c, "mixed", &all, mixed_ns);
+  // 연산 종류별 시간은 그 연산들의 latency 합을 thread 수로 나눈 것 (thread들이 나란히 쓴 시간)
+  report(c, "insert", &h[1], h[1].sum_ns / threads);
+  report(c, "find", &h[2], h[2].sum_ns / threads);
+  report(c, "erase", &h[3], h[3].sum_ns / threads);
+
+  const size_t size = rbshard_size(shard);
+  key_t *keys = (key_t *)malloc((size > 0 ? size : 1) * sizeof(key_t));
+  if (keys != NULL){
+    begin = now_ns();
+    rbshard_to_array(shard, keys, size);
+    hist_add(&h[4], now_ns() - begin);
+    report(c, "scan", &h[4], h[4].sum_ns);
+    free(keys);
+  }
+
+  delete_rbshard(shard);
+  free(workers);
+  free(h);
+  return 0;
+}
+
+// n개를 넣는 build 단계와 insert/find/erase를 섞은 mixed 단계, 전체를 순서대로 꺼내는 scan 단계를 잰다.
+static int run_bench(const bench_config *c){
+  if (c->workload == WL_PQ){
+    if (c->backend != BE_RBTREE){
+      // pq는 rbtree의 노드를 들고 key를 바꾸므로 다른 backend에는 없다.
+      return 0;
+    }
+    return run_pq_bench(c);
+  }
+  if (c->backend == BE_RBSHARD){
+    return run_shard_bench(c);
+  }
+  keygen_t g = {c, {c->seed}, {0}, 0};
+  if (c->workload == WL_ZIPF){
+    zipf_init(&g.zipf, c->n);
+  }
+  histogram_t *h = (histogram_t *)calloc(7, sizeof(histogram_t));
+  bench_tree t;
+  if (h == NULL || !tree_open(&t, c->backend)){
+    fprintf(stderr, "driver: out of memory\n");
+    return 1;
+  }
+
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < c->n; i++){
+    const key_t key = insert_key(&g, g.inserted++);
+    const uint64_t begin = now_ns();
+    tree_insert(&t, key);
+    hist_add(&h[0], now_ns() - begin);
+  }
+  report(c, "build", &h[0], now_ns() - start);
+
+  // h[1..3]: mixed 단계의 insert, find, erase. 전체는 셋을 합친 것
+  const unsigned int total_weight = c->mix[0] + c->mix[1] + c->mix[2];
+  const size_t ops = c->ops > 0 ? c->ops : c->n;
+  volatile size_t found = 0;
+  start = now_ns();
+  for (size_t i = 0; i < ops && total_weight > 0; i++){
+    const unsigned int pick = rng_next(&g.rng) % total_weight;
+    if (pick < c->mix[0]){
+      const key_t key = insert_key(&g, g.inserted++);
+      const uint64_t begin = now_ns();
+      tree_insert(&t, key);
+      hist_add(&h[1], now_ns() - begin);
+    } else if (pick < c->mix[0] + c->mix[1]){
+      const key_t key = lookup_key(&g);
+      const uint64_t begin = now_ns();
+      found += tree_find(&t, key);
+      hist_add(&h[2], now_ns() - begin);
+    } else {
+      const key_t key = lookup_key(&g);
+      const uint64_t begin = now_ns();
+      tree_erase(&t, key);
+      hist_add(&h[3], now_ns() - begin);
+    }
+  }
+  const uint64_t elapsed = now_ns() - start;
+  histogram_t all = {{0}, 0, 0};
+  for (int k = 1; k <= 3; k++){
+    for (size_t b = 0; b < HIST_BUCKETS; b++){
+      all.count[b] += h[k].count[b];
+    }
+    all.total += h[k].total;
+  }
+  report(c, "mixed", &all, elapsed);
+  // 연산 종류별 시간은 그 연산들의 latency 합
+  report(c, "insert", &h[1], h[1].sum_ns);
+  report(c, "find", &h[2], h[2].sum_ns);
+  report(c, "erase", &h[3], h[3].sum_ns);
+
+  // find_seq/find_batch: 같은 key 묶음을 rbtree_find 반복과 rbtree_find_batch로 찾는다.
+  // 앞 단계가 cache를 데워 주지 않도록 묶음마다 번갈아 하지 않고 같은 key 순서를 처음부터 다시 만든다.
+  // latency는 묶음 안의 key당 평균
+  if (c->backend == BE_RBTREE){
+    enum { BATCH = 256 };
+    key_t batch_keys[BATCH];
+    node_t *batch_out[BATCH];
+    const rng_t saved = g.rng;
+    for (int pass = 0; pass < 2; pass++){
+      g.rng = saved;
+      for (size_t done = 0; done < ops; done += BATCH){
+        const size_t count = ops - done < BATCH ? ops - done : BATCH;
+        for (size_t i = 0; i < count; i++){
+          batch_keys[i] = lookup_key(&g);
+        }
+        const uint64_t begin = now_ns();
+        if (pass == 0){
+          for (size_t i = 0; i < count; i++){
+            batch_out[i] = rbtree_find(t.rb, batch_keys[i]);
+          }
+        } else {
+          rbtree_find_batch(t.rb, batch_keys, count, batch_out);
+        }
+        hist_add_many(&h[5 + pass], (now_ns() - begin) / count, count);
+        found += batch_out[count - 1] != NULL;
+      }
+    }
+    report(c, "find_seq", &h[5], h[5].sum_ns);
+    report(c, "find_batch", &h[6], h[6].sum_ns);
+  }
+
+  // scan: 모든 key를 to_array로 한 번 꺼낸다. (연산 수는 1, 시간이 곧 전체를 읽는 시간)
+  const size_t size = tree_size(&t);
+  key_t *keys = (key_t *)malloc((size > 0 ? size : 1) * sizeof(key_t));
+  if (keys != NULL){
+    const uint64_t begin = now_ns();
+    found += tree_to_array(&t, keys, size);
+    hist_add(&h[4], now_ns() - begin);
+    report(c, "scan", &h[4], h[4].sum_ns);
+    free(keys);
+  }
+
+  tree_close(&t);
+  free(h);
+  return 0;
+}
+
+// ---- 명령행 ----
+
+static void usage(void){
+  fprintf(stderr,
+          "usage: driver [-w workloads] [-b backends] [-n sizes] [-j threads] [-o ops] [-m insert:find:erase] [-s seed] [-f text|csv|json] [-t tag]\n"
+          "  -w  comma separated: random,sorted,reverse,zipf,dup,pq (default random)\n"
+          "  -b  comma separated: rbtree,bptree,gen,rbshard (default rbtree; pq runs on rbtree only)\n"
+          "  -n  comma separated sizes, 1e6 style allowed (default 1e6)\n"
+          "  -j  comma separated thread counts for rbshard (default 1)\n"
+          "  -o  mixed phase operations (default n)\n"
+          "  -m  mixed phase ratio (default 1:8:1)\n");
+}
+
+// "1e3,1e6" 같은 크기 목록을 읽는다. 개수를 반환하고 틀리면 0
+static size_t parse_sizes(char *arg, size_t *sizes, const size_t max){
+  size_t count = 0;
+  for (char *tok = strtok(arg, ","); tok != NULL && count < max; tok = strtok(NULL, ",")){
+    char *end;
+    const double value = strtod(tok, &end);
+    if (*end != '\0' || value < 1 || value > 1e12){
+      return 0;
+    }
+    sizes[count++] = (size_t)value;
+  }
+  return count;
+}
+
+static size_t parse_workloads(char *arg, workload_t *workloads){
+  size_t count = 0;
+  for (char *tok = strtok(arg, ","); tok != NULL && count < WL_COUNT; tok = strtok(NULL, ",")){
+    workload_t w = WL_COUNT;
+    for (int i = 0; i < WL_COUNT; i++){
+      if (strcmp(tok, workload_names[i]) == 0){
+        w = (workload_t)i;
+      }
+    }
+    if (w == WL_COUNT){
+      return 0;
+    }
+    workloads[count++] = w;
+  }
+  return count;
+}
+
+static size_t parse_backends(char *arg, backend_t *backends){
+  size_t count = 0;
+  for (char *tok = strtok(arg, ","); tok != NULL && count < BE_COUNT; tok = strtok(NULL, ",")){
+    backend_t b = BE_COUNT;
+    for (int i = 0; i < BE_COUNT; i++){
+      if (strcmp(tok, backend_names[i]) == 0){
+        b = (backend_t)i;
+      }
+    }
+    if (b == BE_COUNT){
+      return 0;
+    }
+    backends[count++] = b;
+  }
+  return count;
+}
 
 int main(int argc, char *argv[]) {
+  bench_config config = {WL_RANDOM, BE_RBTREE, 0, 0, {1, 8, 1}, 1, 1, FMT_TEXT, NULL};
+  workload_t workloads[WL_COUNT] = {WL_RANDOM};
+  size_t num_workloads = 1;
+  backend_t backends[BE_COUNT] = {BE_RBTREE};
+  size_t num_backends = 1;
+  size_t sizes[32] = {1000000};
+  size_t num_sizes = 1;
+  size_t threads[32] = {1};
+  size_t num_threads = 1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "w:b:n:j:o:m:s:f:t:h")) != -1){
+    switch (opt){
+    case 'w':
+      num_workloads = parse_workloads(optarg, workloads);
+      break;
+    case 'b':
+      num_backends = parse_backends(optarg, backends);
+      break;
+    case 'n':
+      num_sizes = parse_sizes(optarg, sizes, 32);
+      break;
+    case 'j':
+      num_threads = parse_sizes(optarg, threads, 32);
+      break;
+    case 'o':
+      config.ops = (size_t)strtod(optarg, NULL);
+      break;
+    case 'm':
+      if (sscanf(optarg, "%u:%u:%u", &config.mix[0], &config.mix[1], &config.mix[2]) != 3){
+        num_workloads = 0;
+      }
+      break;
+    case 's':
+      config.seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'f':
+      config.format = strcmp(optarg, "csv") == 0 ? FMT_CSV : strcmp(optarg, "json") == 0 ? FMT_JSON : FMT_TEXT;
+      break;
+    case 't':
+      config.tag = optarg;
+      break;
+    default:
+      usage();
+      return 2;
+    }
+  }
+  if (num_workloads == 0 || num_backends == 0 || num_sizes == 0 || num_threads == 0){
+    usage();
+    return 2;
+  }
 
-}
\ No newline at end of file
+  print_header(config.format);
+  int status = 0;
+  for (size_t w = 0; w < num_workloads; w++){
+    for (size_t s = 0; s < num_sizes; s++){
+      // 같은 workload와 크기의 backend들은 연달아 재서 결과가 나란히 나오게 한다.
+      // rbshard는 thread 수마다 한 번씩, 나머지는 thread 수와 상관없이 한 번만 잰다.
+      for (size_t run = 0; run < num_backends * num_threads; run++){
+        const size_t b = run / num_threads;
+        if (backends[b] != BE_RBSHARD && run % num_threads != 0){
+          continue;
+        }
+        config.workload = workloads[w];
+        config.backend = backends[b];
+        config.n = sizes[s];
+        config.threads = threads[run % num_threads];
+        fflush(stdout);
+        // 조합마다 새 process에서 재야 peak RSS가 그 조합의 값이 된다.
+        pid_t pid = fork();
+        if (pid == 0){
+          int result = run_bench(&config);
+          fflush(stdout);
+          _exit(result);
+        }
+        int child_status = 1;
+        if (pid < 0 || waitpid(pid, &child_status, 0) < 0 || !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0){
+          fprintf(stderr, "driver: %s %s n=%zu failed\n", backend_names[config.backend], workload_names[config.workload],
+                  config.n);
+          status = 1;
+        }
+      }
+    }
+  }
+  return status;
+}
@@ -0,0 +1,301 @@
+#include "prbtree.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// 노드는 여러 handle이 공유하고 다른 thread에서 해제될 수 있으므로 tree별 pool 대신 malloc을 쓴다.
+
+prbtree *new_prbtree(void){
+  return (prbtree *)calloc(1, sizeof(prbtree));
+}
+
+static void pnode_retain(pnode_t *node){
+  if (node != NULL){
+    __atomic_fetch_add(&node->ref, 1, __ATOMIC_RELAXED);
+  }
+}
+
+// 참조를 하나 줄이고 0이 되면 해제한 뒤 자식의 참조도 줄인다.
+// 공유된 노드를 만나면 거기서 멈추므로 다른 version과 같이 쓰는 부분은 남는다.
+static void pnode_release(pnode_t *node){
+  while (node != NULL && __atomic_sub_fetch(&node->ref, 1, __ATOMIC_ACQ_REL) == 0){
+    pnode_release(node->left);
+    pnode_t *right = node->right;
+    free(node);
+    node = right;
+  }
+}
+
+void delete_prbtree(prbtree *t){
+  pnode_release(t->root);
+  while (t->reserve != NULL){
+    pnode_t *next = t->reserve->left;
+    free(t->reserve);
+    t->reserve = next;
+  }
+  free(t);
+}
+
+// 지금 version을 O(1)에 복사한다. root의 참조만 늘리고, 이후 어느 쪽을 수정하든 경로만 복사된다.
+prbtree *prbtree_snapshot(prbtree *t){
+  prbtree *snapshot = new_prbtree();
+  if (snapshot == NULL){
+    return NULL;
+  }
+  pnode_retain(t->root);
+  snapshot->root = t->root;
+  snapshot->size = t->size;
+  return snapshot;
+}
+
+// 수정 한 번에 필요한 노드 수의 상한만큼 예비 노드를 채워 둔다. 실패하면 -1 (tree는 그대로)
+// left-leaning rbtree의 높이는 2 log(n + 1) 이하이고, 한 level에서 최대 6개의 노드를 복사한다.
+static int reserve_nodes(prbtree *t){
+  size_t height = 2;
+  for (size_t n = t->size + 1; n > 1; n >>= 1){
+    height += 2;
+  }
+  const size_t need = 6 * height;
+  while (t->reserve_count < need){
+    pnode_t *node = (pnode_t *)malloc(sizeof(pnode_t));
+    if (node == NULL){
+      return -1;
+    }
+    node->left = t->reserve;
+    t->reserve = node;
+    t->reserve_count++;
+  }
+  return 0;
+}
+
+static pnode_t *take_node(prbtree *t){
+  pnode_t *node = t->reserve;
+  t->reserve = node->left;
+  t->reserve_count--;
+  return node;
+}
+
+// 수정하려는 노드를 이 version만 쓰는 노드로 바꾼다.
+// 참조가 하나뿐이면 (이 경로로만 닿는 노드) 그대로 쓰고, 공유 중이면 복사해서 바꿔 끼운다.
+// 호출하는 쪽은 node를 가리키는 참조 하나를 넘기고 반환값의 참조를 받는다.
+static pnode_t *own(prbtree *t, pnode_t *node){
+  if (__atomic_load_n(&node->ref, __ATOMIC_ACQUIRE) == 1){
+    return node;
+  }
+  pnode_t *copy = take_node(t);
+  // ref는 다른 thread가 바꾸는 중일 수 있으므로 나머지 field만 복사한다.
+  copy->left = node->left;
+  copy->right = node->right;
+  copy->key = node->key;
+  copy->color = node->color;
+  copy->ref = 1;
+  pnode_retain(copy->left);
+  pnode_retain(copy->right);
+  pnode_release(node);
+  return copy;
+}
+
+static inline bool is_red(const pnode_t *node){
+  return node != NULL && node->color == RBTREE_RED;
+}
+
+// 아래 회전/색 바꾸기는 h가 이미 own된 상태에서 부른다.
+static pnode_t *rotate_left(prbtree *t, pnode_t *h){
+  pnode_t *x = own(t, h->right);
+  h->right = x->left;
+  x->left = h;
+  x->color = h->color;
+  h->color = RBTREE_RED;
+  return x;
+}
+
+static pnode_t *rotate_right(prbtree *t, pnode_t *h){
+  pnode_t *x = own(t, h->left);
+  h->left = x->right;
+  x->right = h;
+  x->color = h->color;
+  h->color = RBTREE_RED;
+  return x;
+}
+
+static void flip_colors(prbtree *t, pnode_t *h){
+  h->left = own(t, h->left);
+  h->right = own(t, h->right);
+  h->color = !h->color;
+  h->left->color = !h->left->color;
+  h->right->color = !h->right->color;
+}
+
+// 오른쪽 red link와 연속된 red link를 없애고 4-node를 쪼갠다.
+static pnode_t *balance(prbtree *t, pnode_t *h){
+  if (is_red(h->right)){
+    h = rotate_left(t, h);
+  }
+  if (is_red(h->left) && is_red(h->left->left)){
+    h = rotate_right(t, h);
+  }
+  if (is_red(h->left) && is_red(h->right)){
+    flip_colors(t, h);
+  }
+  return h;
+}
+
+static pnode_t *insert_at(prbtree *t, pnode_t *h, const key_t key){
+  if (h == NULL){
+    pnode_t *node = take_node(t);
+    node->left = node->right = NULL;
+    node->key = key;
+    node->color = RBTREE_RED;
+    node->ref = 1;
+    return node;
+  }
+  h = own(t, h);
+  // 같은 key는 오른쪽에 넣는다.
+  if (key < h->key){
+    h->left = insert_at(t, h->left, key);
+  } else {
+    h->right = insert_at(t, h->right, key);
+  }
+  return balance(t, h);
+}
+
+// key를 하나 추가한다. 실패하면 -1
+int prbtree_insert(prbtree *t, const key_t key){
+  if (reserve_nodes(t) != 0){
+    return -1;
+  }
+  t->root = insert_at(t, t->root, key);
+  t->root->color = RBTREE_BLACK;
+  t->size++;
+  return 0;
+}
+
+// h의 왼쪽 자식이나 그 왼쪽 자식이 red가 되도록 만든다.
+static pnode_t *move_red_left(prbtree *t, pnode_t *h){
+  flip_colors(t, h);
+  if (is_red(h->right->left)){
+    h->right = rotate_right(t, h->right);
+    h = rotate_left(t, h);
+    flip_colors(t, h);
+  }
+  return h;
+}
+
+static pnode_t *move_red_right(prbtree *t, pnode_t *h){
+  flip_colors(t, h);
+  if (is_red(h->left->left)){
+    h = rotate_right(t, h);
+    flip_colors(t, h);
+  }
+  return h;
+}
+
+static pnode_t *erase_min_at(prbtree *t, pnode_t *h){
+  if (h->left == NULL){
+    // 왼쪽이 비어 있으면 오른쪽도 비어 있다. 공유 중이면 참조만 줄어든다.
+    pnode_release(h);
+    return NULL;
+  }
+  h = own(t, h);
+  if (!is_red(h->left) && !is_red(h->left->left)){
+    h = move_red_left(t, h);
+  }
+  h->left = erase_min_at(t, h->left);
+  return balance(t, h);
+}
+
+// key가 h 아래에 있을 때만 부른다.
+static pnode_t *erase_at(prbtree *t, pnode_t *h, const key_t key){
+  h = own(t, h);
+  if (key < h->key){
+    if (!is_red(h->left) && !is_red(h->left->left)){
+      h = move_red_left(t, h);
+    }
+    h->left = erase_at(t, h->left, key);
+  } else {
+    // 회전으로 같은 key의 다른 노드가 올라올 수 있으므로 (중복 key)
+    // 이 level에서 회전이 없었을 때만 h를 지우고, 아니면 내려간 원래 노드를 오른쪽에서 찾는다.
+    const pnode_t *at = h;
+    if (is_red(h->left)){
+      h = rotate_right(t, h);
+    }
+    if (h == at && key == h->key && h->right == NULL){
+      free(h);
+      return NULL;
+    }
+    if (!is_red(h->right) && !is_red(h->right->left)){
+      h = move_red_right(t, h);
+    }
+    if (h == at && key == h->key){
+      // 오른쪽 서브트리의 최소값을 가져오고 그 노드를 지운다.
+      const pnode_t *successor = h->right;
+      while (successor->left != NULL){
+        successor = successor->left;
+      }
+      h->key = successor->key;
+      h->right = erase_min_at(t, h->right);
+    } else {
+      h->right = erase_at(t, h->right, key);
+    }
+  }
+  return balance(t, h);
+}
+
+// key 하나를 지운다. 성공하면 0, 없거나 메모리가 부족하면 -1
+int prbtree_erase(prbtree *t, const key_t key){
+  if (prbtree_find(t, key) == NULL || reserve_nodes(t) != 0){
+    return -1;
+  }
+  t->root = own(t, t->root);
+  if (!is_red(t->root->left) && !is_red(t->root->right)){
+    t->root->color = RBTREE_RED;
+  }
+  t->root = erase_at(t, t->root, key);
+  if (t->root != NULL){
+    t->root->color = RBTREE_BLACK;
+  }
+  t->size--;
+  return 0;
+}
+
+const pnode_t *prbtree_find(const prbtree *t, const key_t key){
+  const pnode_t *node = t->root;
+  while (node != NULL && node->key != key){
+    node = key < node->key ? node->left : node->right;
+  }
+  return node;
+}
+
+const pnode_t *prbtree_min(const prbtree *t){
+  const pnode_t *node = t->root;
+  while (node != NULL && node->left != NULL){
+    node = node->left;
+  }
+  return node;
+}
+
+const pnode_t *prbtree_max(const prbtree *t){
+  const pnode_t *node = t->root;
+  while (node != NULL && node->right != NULL){
+    node = node->right;
+  }
+  return node;
+}
+
+// 부모 포인터가 없으므로 지나온 노드를 stack에 쌓으며 중위 순회한다.
+size_t prbtree_to_array(const prbtree *t, key_t *arr, const size_t n){
+  // 높이는 2 log(n + 1) 이하라서 size_t bit 수의 두 배면 충분하다.
+  const pnode_t *stack[sizeof(size_t) * 16];
+  size_t top = 0, idx = 0;
+  const pnode_t *node = t->root;
+  while (idx < n && (node != NULL || top > 0)){
+    while (node != NULL){
+      stack[top++] = node;
+      node = node->left;
+    }
+    node = stack[--top];
+    arr[idx++] = node->key;
+    node = node->right;
+  }
+  return idx;
+}
@@ -0,0 +1,39 @@
+#ifndef _PRBTREE_H_
+#define _PRBTREE_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// 수정할 때 root에서 바뀌는 노드까지의 경로만 복사하는 persistent rbtree (left-leaning red-black tree)
+// 부모 포인터가 없어서 한 노드를 여러 version의 tree가 같이 가리킬 수 있다.
+// 노드마다 자기를 가리키는 부모/handle 수를 세고, 0이 되면 해제한다.
+typedef struct pnode_t {
+  struct pnode_t *left, *right;
+  key_t key;
+  color_t color;
+  unsigned int ref;
+} pnode_t;
+
+// tree 하나의 version. snapshot도 같은 handle이다.
+// 한 handle은 한 thread만 쓰고, 서로 다른 handle은 노드를 공유해도 다른 thread에서 동시에 써도 된다.
+typedef struct {
+  pnode_t *root;
+  size_t size;
+  pnode_t *reserve;       // 경로 복사에 쓸 예비 노드 (left로 연결)
+  size_t reserve_count;
+} prbtree;
+
+prbtree *new_prbtree(void);
+void delete_prbtree(prbtree *);
+prbtree *prbtree_snapshot(prbtree *);
+
+int prbtree_insert(prbtree *, const key_t);
+int prbtree_erase(prbtree *, const key_t);
+
+const pnode_t *prbtree_find(const prbtree *, const key_t);
+const pnode_t *prbtree_min(const prbtree *);
+const pnode_t *prbtree_max(const prbtree *);
+size_t prbtree_to_array(const prbtree *, key_t *, const size_t);
+
+#endif  // _PRBTREE_H_
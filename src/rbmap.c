@@ -0,0 +1,160 @@
+#include "rbmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef RBTREE_NO_PARENT
+#error "rbmap은 노드를 직접 연결하며 부모 포인터를 쓰므로 RBTREE_NO_PARENT로 빌드할 수 없다"
+#endif
+
+// size 크기의 타입이 필요로 하는 정렬: size를 나누는 가장 큰 2의 거듭제곱 (최대 max_align_t)
+static size_t align_of_size(size_t size){
+  size_t align = 1;
+  while (align < _Alignof(max_align_t) && size % (align * 2) == 0){
+    align *= 2;
+  }
+  return align;
+}
+
+static size_t align_up(size_t offset, size_t align){
+  return (offset + align - 1) / align * align;
+}
+
+// key는 node_t 바로 뒤, 어떤 key 타입에도 맞는 정렬 위치에 둔다. rbmap_key는 map을 받지 않으므로 모든 map에 같은 위치를 쓴다.
+// (option에 따라 node_t가 40byte가 되면 sizeof(node_t) 그대로는 16byte 정렬이 아님)
+static inline size_t key_offset(void){
+  return align_up(sizeof(node_t), _Alignof(max_align_t));
+}
+
+rbmap *new_rbmap(const size_t key_size, const size_t value_size, rbmap_comp_t comp){
+  rbmap *m = (rbmap *)calloc(1, sizeof(rbmap));
+  if (m == NULL){
+    return NULL;
+  }
+  m->tree = new_rbtree();
+  if (m->tree == NULL){
+    free(m);
+    return NULL;
+  }
+  m->comp = comp;
+  m->key_size = key_size;
+  m->value_size = value_size;
+
+  // 노드 = node_t | key | value, 각 부분은 자기 정렬에 맞추고 노드 전체는 그중 가장 큰 정렬로 맞춘다.
+  size_t key_align = align_of_size(key_size);
+  size_t value_align = align_of_size(value_size);
+  size_t node_align = _Alignof(node_t);
+  node_align = key_align > node_align ? key_align : node_align;
+  node_align = value_align > node_align ? value_align : node_align;
+
+  m->value_offset = align_up(key_offset() + key_size, value_align);
+  m->tree->pool.node_size = align_up(m->value_offset + value_size, node_align);
+  return m;
+}
+
+void delete_rbmap(rbmap *m){
+  // 노드는 모두 tree의 pool에 있으므로 tree만 지우면 된다.
+  delete_rbtree(m->tree);
+  free(m);
+}
+
+void *rbmap_key(const node_t *node){
+  return (char *)node + key_offset();
+}
+
+void *rbmap_value(const rbmap *m, const node_t *node){
+  return (char *)node + m->value_offset;
+}
+
+node_t *rbmap_find_node(const rbmap *m, const void *key){
+  const rbtree *t = m->tree;
+  node_t *current_node = t->root;
+  while (current_node != t->nil){
+    int c = m->comp(key, rbmap_key(current_node));
+    if (c == 0){
+      return current_node;
+    } else if (c < 0){
+      current_node = current_node->left;
+    } else {
+      current_node = current_node->right;
+    }
+  }
+  return NULL;
+}
+
+// key에 해당하는 value의 위치를 반환한다. 없으면 NULL
+void *rbmap_find(const rbmap *m, const void *key){
+  node_t *node = rbmap_find_node(m, key);
+  return node != NULL ? rbmap_value(m, node) : NULL;
+}
+
+// key, value를 넣고 노드 안의 value 위치를 반환한다. 이미 있는 key면 value만 덮어쓴다.
+// value가 NULL이면 0으로 채운다. 메모리가 부족하면 NULL
+void *rbmap_insert(rbmap *m, const void *key, const void *value){
+  rbtree *t = m->tree;
+  node_t *parent_node = t->nil;
+  node_t *current_node = t->root;
+  int c = 0;
+  while (current_node != t->nil){
+    c = m->comp(key, rbmap_key(current_node));
+    if (c == 0){
+      void *slot = rbmap_value(m, current_node);
+      if (value != NULL){
+        memcpy(slot, value, m->value_size);
+      }
+      return slot;
+    }
+    parent_node = current_node;
+    current_node = c < 0 ? current_node->left : current_node->right;
+  }
+
+  node_t *new_node = node_alloc(t);
+  if (new_node == NULL){
+    return NULL;
+  }
+  rbtree_set_color(new_node, RBTREE_RED);
+  new_node->key = 0;
+  new_node->left = new_node->right = t->nil;
+  rbtree_set_parent(new_node, parent_node);
+  memcpy(rbmap_key(new_node), key, m->key_size);
+  if (value != NULL){
+    memcpy(rbmap_value(m, new_node), value, m->value_size);
+  } else {
+    memset(rbmap_value(m, new_node), 0, m->value_size);
+  }
+
+  if (parent_node == t->nil){
+    t->root = new_node;
+    t->leftmost = t->rightmost = new_node;
+  } else if (c < 0){
+    parent_node->left = new_node;
+    if (parent_node == t->leftmost){
+      t->leftmost = new_node;
+    }
+  } else {
+    parent_node->right = new_node;
+    if (parent_node == t->rightmost){
+      t->rightmost = new_node;
+    }
+  }
+  t->size++;
+#ifdef RBTREE_ORDER_STATS
+  // 새 key라는 것이 확인된 뒤에 경로의 서브트리 크기를 늘린다.
+  new_node->size = 1;
+  for (node_t *node = parent_node; node != t->nil; node = rbtree_parent(node)){
+    node->size++;
+  }
+#endif
+  rbtree_insert_fixup(t, new_node);
+  return rbmap_value(m, new_node);
+}
+
+// key를 지운다. 성공하면 0, key가 없으면 -1
+int rbmap_erase(rbmap *m, const void *key){
+  node_t *node = rbmap_find_node(m, key);
+  if (node == NULL){
+    return -1;
+  }
+  // rbtree_erase는 다른 노드의 key를 옮기지 않으므로 key/value를 복사할 필요가 없고 다른 value 위치도 그대로다.
+  return rbtree_erase(m->tree, node);
+}
@@ -0,0 +1,30 @@
+#ifndef _RBMAP_H_
+#define _RBMAP_H_
+
+#include "rbtree.h"
+
+// key 비교 함수 (qsort와 같은 규칙: 음수, 0, 양수)
+typedef int (*rbmap_comp_t)(const void *, const void *);
+
+// key -> value map. 노드 연결, 색, 회전, pool은 rbtree를 그대로 쓰고
+// key와 value는 node_t 바로 뒤에 inline으로 저장한다. (node_t의 key 필드는 쓰지 않음)
+// payload를 포인터로 두고 싶으면 value_size를 sizeof(void *)로 만들면 된다.
+typedef struct {
+  rbtree *tree;
+  rbmap_comp_t comp;
+  size_t key_size, value_size;
+  size_t value_offset;  // 노드 시작부터 value까지의 byte 수
+} rbmap;
+
+rbmap *new_rbmap(const size_t, const size_t, rbmap_comp_t);
+void delete_rbmap(rbmap *);
+
+void *rbmap_insert(rbmap *, const void *, const void *);
+void *rbmap_find(const rbmap *, const void *);
+node_t *rbmap_find_node(const rbmap *, const void *);
+int rbmap_erase(rbmap *, const void *);
+
+void *rbmap_key(const node_t *);
+void *rbmap_value(const rbmap *, const node_t *);
+
+#endif  // _RBMAP_H_
@@ -0,0 +1,245 @@
+#include "rbshard.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// shard 범위의 시작 값은 rebalance만 바꾸고 (모든 shard lock을 잡은 상태)
+// 다른 연산은 lock 없이 읽어서 shard를 고른 뒤 lock을 잡고 다시 확인한다.
+static key_t load_lo(const rbshard_part *part){
+  return __atomic_load_n(&part->lo, __ATOMIC_RELAXED);
+}
+
+static void store_lo(rbshard_part *part, key_t lo){
+  __atomic_store_n(&part->lo, lo, __ATOMIC_RELAXED);
+}
+
+// n개의 shard가 int 범위 전체를 같은 크기로 나눠 맡도록 만든다.
+rbshard *new_rbshard(const size_t n){
+  if (n == 0){
+    return NULL;
+  }
+  rbshard *s = (rbshard *)calloc(1, sizeof(rbshard));
+  if (s == NULL){
+    return NULL;
+  }
+  s->parts = (rbshard_part *)aligned_alloc(_Alignof(rbshard_part), n * sizeof(rbshard_part));
+  if (s->parts == NULL){
+    free(s);
+    return NULL;
+  }
+  s->n = n;
+  const int64_t span = (int64_t)UINT_MAX + 1;
+  for (size_t i = 0; i < n; i++){
+    rbshard_part *part = &s->parts[i];
+    pthread_mutex_init(&part->lock, NULL);
+    part->lo = (key_t)(INT_MIN + (int64_t)i * (span / (int64_t)n));
+    part->tree = new_rbtree();
+    if (part->tree == NULL){
+      pthread_mutex_destroy(&part->lock);
+      s->n = i;
+      delete_rbshard(s);
+      return NULL;
+    }
+  }
+  return s;
+}
+
+void delete_rbshard(rbshard *s){
+  for (size_t i = 0; i < s->n; i++){
+    delete_rbtree(s->parts[i].tree);
+    pthread_mutex_destroy(&s->parts[i].lock);
+  }
+  free(s->parts);
+  free(s);
+}
+
+// key가 들어갈 shard를 찾아 lock을 잡고 반환한다.
+// 찾는 사이에 rebalance로 범위가 바뀌었으면 다시 찾는다.
+static rbshard_part *lock_part(rbshard *s, const key_t key){
+  for (;;){
+    // lo <= key 인 마지막 shard를 이분 탐색
+    size_t lo = 0, hi = s->n;
+    while (hi - lo > 1){
+      size_t mid = lo + (hi - lo) / 2;
+      if (load_lo(&s->parts[mid]) <= key){
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    rbshard_part *part = &s->parts[lo];
+    pthread_mutex_lock(&part->lock);
+    // lock을 잡은 동안에는 rebalance가 못 돌기 때문에 범위가 고정된다.
+    if (part->lo <= key && (lo + 1 == s->n || key < s->parts[lo + 1].lo)){
+      return part;
+    }
+    pthread_mutex_unlock(&part->lock);
+  }
+}
+
+int rbshard_insert(rbshard *s, const key_t key){
+  rbshard_part *part = lock_part(s, key);
+  node_t *node = rbtree_insert(part->tree, key);
+  pthread_mutex_unlock(&part->lock);
+  return node != NULL ? 0 : -1;
+}
+
+bool rbshard_contains(rbshard *s, const key_t key){
+  rbshard_part *part = lock_part(s, key);
+  bool found = rbtree_find(part->tree, key) != NULL;
+  pthread_mutex_unlock(&part->lock);
+  return found;
+}
+
+// key 하나를 지운다. 성공하면 0, 없으면 -1
+int rbshard_erase(rbshard *s, const key_t key){
+  rbshard_part *part = lock_part(s, key);
+  node_t *node = rbtree_find(part->tree, key);
+  if (node != NULL){
+    rbtree_erase(part->tree, node);
+  }
+  pthread_mutex_unlock(&part->lock);
+  return node != NULL ? 0 : -1;
+}
+
+// 앞쪽 shard부터 보면서 처음 비어있지 않은 shard의 최소값
+bool rbshard_min(rbshard *s, key_t *key){
+  for (size_t i = 0; i < s->n; i++){
+    rbshard_part *part = &s->parts[i];
+    pthread_mutex_lock(&part->lock);
+    node_t *node = rbtree_min(part->tree);
+    bool found = node != NULL;
+    if (found){
+      *key = node->key;
+    }
+    pthread_mutex_unlock(&part->lock);
+    if (found){
+      return true;
+    }
+  }
+  return false;
+}
+
+// 뒤쪽 shard부터 보면서 처음 비어있지 않은 shard의 최대값
+bool rbshard_max(rbshard *s, key_t *key){
+  for (size_t i = s->n; i > 0; i--){
+    rbshard_part *part = &s->parts[i - 1];
+    pthread_mutex_lock(&part->lock);
+    node_t *node = rbtree_max(part->tree);
+    bool found = node != NULL;
+    if (found){
+      *key = node->key;
+    }
+    pthread_mutex_unlock(&part->lock);
+    if (found){
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t rbshard_size(rbshard *s){
+  size_t size = 0;
+  for (size_t i = 0; i < s->n; i++){
+    pthread_mutex_lock(&s->parts[i].lock);
+    size += s->parts[i].tree->size;
+    pthread_mutex_unlock(&s->parts[i].lock);
+  }
+  return size;
+}
+
+// shard 순서대로 key를 arr에 최대 n개 넣는다.
+// shard는 하나씩 lock을 잡으므로 다른 thread가 쓰는 중이면 전체가 한 시점의 모습은 아니다.
+size_t rbshard_to_array(rbshard *s, key_t *arr, const size_t n){
+  size_t idx = 0;
+  for (size_t i = 0; i < s->n && idx < n; i++){
+    pthread_mutex_lock(&s->parts[i].lock);
+    idx += rbtree_to_array(s->parts[i].tree, arr + idx, n - idx);
+    pthread_mutex_unlock(&s->parts[i].lock);
+  }
+  return idx;
+}
+
+// 모든 key를 순서대로 fn에 넘긴다. fn이 false를 반환하면 멈춘다.
+// fn은 shard lock을 잡은 채 불리므로 안에서 같은 rbshard를 수정하면 안 된다.
+void rbshard_foreach(rbshard *s, bool (*fn)(key_t, void *), void *ctx){
+  for (size_t i = 0; i < s->n; i++){
+    rbshard_part *part = &s->parts[i];
+    bool keep_going = true;
+    pthread_mutex_lock(&part->lock);
+    for (node_t *node = rbtree_min(part->tree); keep_going && node != NULL; node = rbtree_next(part->tree, node)){
+      keep_going = fn(node->key, ctx);
+    }
+    pthread_mutex_unlock(&part->lock);
+    if (!keep_going){
+      return;
+    }
+  }
+}
+
+// 각 shard가 비슷한 수의 key를 갖도록 경계를 다시 정하고 key를 옮긴다. 실패하면 -1 (그대로 유지)
+// 모든 shard의 lock을 순서대로 잡으므로 그동안 다른 연산은 멈춘다.
+int rbshard_rebalance(rbshard *s){
+  for (size_t i = 0; i < s->n; i++){
+    pthread_mutex_lock(&s->parts[i].lock);
+  }
+
+  int result = -1;
+  size_t total = 0;
+  for (size_t i = 0; i < s->n; i++){
+    total += s->parts[i].tree->size;
+  }
+  key_t *keys = (key_t *)malloc((total > 0 ? total : 1) * sizeof(key_t));
+  rbtree **trees = (rbtree **)calloc(s->n, sizeof(rbtree *));
+  key_t *los = (key_t *)malloc(s->n * sizeof(key_t));
+  if (keys == NULL || trees == NULL || los == NULL){
+    goto done;
+  }
+  // shard 순서 = key 순서이므로 이어 붙이면 전체가 정렬된 배열
+  size_t idx = 0;
+  for (size_t i = 0; i < s->n; i++){
+    idx += rbtree_to_array(s->parts[i].tree, keys + idx, total - idx);
+  }
+
+  // i번째 shard는 정렬된 배열의 i * total / n 번째 key부터 시작
+  // 같은 key는 같은 shard에 있어야 하므로 경계는 key 값으로 정하고, 경계 값과 같은 key는 모두 뒤 shard로 간다.
+  los[0] = INT_MIN;
+  for (size_t i = 1; i < s->n; i++){
+    los[i] = total > 0 ? keys[i * total / s->n] : s->parts[i].lo;
+    if (los[i] < los[i - 1]){
+      los[i] = los[i - 1];
+    }
+  }
+  size_t begin = 0;
+  for (size_t i = 0; i < s->n; i++){
+    size_t end = begin;
+    while (end < total && (i + 1 == s->n || keys[end] < los[i + 1])){
+      end++;
+    }
+    trees[i] = rbtree_from_sorted_array(keys + begin, end - begin);
+    if (trees[i] == NULL){
+      for (size_t j = 0; j < i; j++){
+        delete_rbtree(trees[j]);
+      }
+      goto done;
+    }
+    begin = end;
+  }
+
+  for (size_t i = 0; i < s->n; i++){
+    delete_rbtree(s->parts[i].tree);
+    s->parts[i].tree = trees[i];
+    store_lo(&s->parts[i], los[i]);
+  }
+  result = 0;
+
+done:
+  free(keys);
+  free(trees);
+  free(los);
+  for (size_t i = s->n; i > 0; i--){
+    pthread_mutex_unlock(&s->parts[i - 1].lock);
+  }
+  return result;
+}
@@ -0,0 +1,37 @@
+#ifndef _RBSHARD_H_
+#define _RBSHARD_H_
+
+#include <pthread.h>
+
+#include "rbtree.h"
+
+// key 범위를 나눠서 여러 개의 rbtree에 담고 tree마다 lock을 따로 두는 container
+// 서로 다른 shard에 들어가는 연산은 동시에 진행된다.
+// 여러 thread가 같이 쓰므로 node 포인터 대신 key 값으로 주고받는다.
+typedef struct {
+  _Alignas(64) pthread_mutex_t lock;  // shard끼리 cache line을 나눠 쓰지 않도록 정렬
+  rbtree *tree;
+  key_t lo;  // 이 shard가 맡는 범위의 시작 (포함), 다음 shard의 lo 전까지
+} rbshard_part;
+
+typedef struct {
+  size_t n;
+  rbshard_part *parts;
+} rbshard;
+
+rbshard *new_rbshard(const size_t);
+void delete_rbshard(rbshard *);
+
+int rbshard_insert(rbshard *, const key_t);
+bool rbshard_contains(rbshard *, const key_t);
+int rbshard_erase(rbshard *, const key_t);
+
+bool rbshard_min(rbshard *, key_t *);
+bool rbshard_max(rbshard *, key_t *);
+size_t rbshard_size(rbshard *);
+size_t rbshard_to_array(rbshard *, key_t *, const size_t);
+void rbshard_foreach(rbshard *, bool (*)(key_t, void *), void *);
+
+int rbshard_rebalance(rbshard *);
+
+#endif  // _RBSHARD_H_
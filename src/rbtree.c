@@ -2,31 +2,190 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+
+// node pool chunk 크기: 처음엔 작게 시작해서 두 배씩 늘리되 최대 크기를 넘지 않는다.
+#define NODE_CHUNK_MIN 64
+#define NODE_CHUNK_MAX 65536
+
+// RBTREE_STATS가 없으면 아무 코드도 만들지 않는다.
+// find처럼 const rbtree를 받는 함수에서도 세야 하므로 const를 떼고 쓴다. (rbtree는 항상 new_rbtree로 만든 객체)
+#ifdef RBTREE_STATS
+#define RBTREE_STAT_ADD(t, field, n) (((rbtree *)(t))->stats.field += (n))
+#define RBTREE_STAT_DEPTH(t, field) do { \
+    rbtree_stats *stats_ = &((rbtree *)(t))->stats; \
+    if (++stats_->fixup_depth > stats_->field){ \
+      stats_->field = stats_->fixup_depth; \
+    } \
+  } while (0)
+#else
+#define RBTREE_STAT_ADD(t, field, n) ((void)0)
+#define RBTREE_STAT_DEPTH(t, field) ((void)0)
+#endif
+
+#ifdef RBTREE_ORDER_STATS
+// 자식들의 서브트리 크기가 맞을 때 노드의 서브트리 크기를 다시 계산한다. (RBTREE_COUNTED면 노드의 count만큼 더함)
+static inline void rbtree_update_size(node_t *node){
+  node->size = node->left->size + node->right->size + rbtree_node_count(node);
+}
+#endif
+
+// 모든 트리가 같이 쓰는 nil 노드. split/join으로 노드가 다른 트리로 옮겨 가도 leaf를 고칠 필요가 없다.
+// 여러 thread의 트리가 동시에 읽으므로 절대 쓰지 않는다. (nil일 수 있는 노드의 부모/색을 바꿀 때는 먼저 확인)
+static node_t rbtree_nil = {
+#ifdef RBTREE_PACKED_COLOR
+  .parent_color = RBTREE_BLACK,
+#else
+  .color = RBTREE_BLACK,
+#endif
+};
 
 rbtree *new_rbtree(void) {
   rbtree *p = (rbtree *)calloc(1, sizeof(rbtree));
-  
-  // nil 노드 생성 *nil을 사용해서 nil의 값 지정, (node_t *) 사용해서 calloc으로 지정한 크기 타입 캐스팅
-  node_t *nil = (node_t *)calloc(1, sizeof(node_t));
+  if (p == NULL){
+    return NULL;
+  }
+  // 첫 초기화 트리이기 때문에 트리의 root를 nil 노드로 지정
+  p->nil = p->root = p->leftmost = p->rightmost = &rbtree_nil;
+  p->pool.node_size = sizeof(node_t);
+  return p;
+}
 
-  // nil 노드는 무조건 black
-  nil->color = RBTREE_BLACK;
+// 정렬된 배열로부터 회전 없이 O(n)에 트리를 만든다. rbtree_to_array의 역함수
+rbtree *rbtree_from_sorted_array(const key_t *arr, const size_t n) {
+  rbtree *t = new_rbtree();
+  if (t == NULL || n == 0){
+    return t;
+  }
+#ifdef RBTREE_NO_PARENT
+  if (n > RBTREE_SIZE_MAX){
+    delete_rbtree(t);
+    return NULL;
+  }
+#endif
 
-  // 첫 초기화 트리이기 때문에 트리의 root와 nil을 nil 노드로 지정 이것으로 nil 노드를 하나만 써도 됨.
-  p->nil = p->root = nil;
-  return p;
+  // 먼저 key 순서대로 노드를 만들어서 right 포인터로 연결된 리스트를 만든다. (뒤에서부터 앞에 붙이기)
+  node_t *list = NULL;
+  size_t nodes = 0;
+  for (size_t i = n; i > 0; i--){
+#ifdef RBTREE_COUNTED
+    // 같은 key가 이어지면 노드를 새로 만들지 않고 count만 늘린다.
+    if (list != NULL && list->key == arr[i - 1]){
+      list->count++;
+      continue;
+    }
+#endif
+    node_t *node = node_alloc(t);
+    if (node == NULL){
+      delete_rbtree(t);
+      return NULL;
+    }
+    node->key = arr[i - 1];
+    node->right = list;
+    list = node;
+    nodes++;
+  }
+
+  rbtree_rebuild_from_list(t, list, nodes);
+  return t;
+}
+
+// 리스트의 앞 n개 노드로 서브트리를 만들고 black height를 height에 돌려준다.
+static node_t *rbtree_build_subtree(rbtree *t, node_t **list, const size_t n, int *height){
+  // 꽉 찬 레벨의 수 = floor(log2(n + 1)), 그 아래 마지막 레벨의 노드만 RED로 칠한다.
+  int full_levels = 0;
+  while (((size_t)2 << full_levels) - 1 <= n){
+    full_levels++;
+  }
+  *height = full_levels;
+  return rbtree_build_from_list(t, list, n, t->nil, 0, full_levels);
+}
+
+// key 순서로 연결된 n개 노드의 리스트로 트리 전체를 다시 만든다.
+void rbtree_rebuild_from_list(rbtree *t, node_t *list, size_t n){
+  node_t *last = t->nil;
+  size_t keys = 0;
+#ifdef RBTREE_NO_PARENT
+  // 리스트 순서대로 seq를 다시 매긴다. (합친 리스트에서는 같은 key의 seq 순서가 섞여 있을 수 있음)
+  t->finger.len = 0;
+  t->next_seq = 0;
+#endif
+  for (node_t *node = list; node != NULL; node = node->right){
+    last = node;
+    keys += rbtree_node_count(node);
+#ifdef RBTREE_NO_PARENT
+    node->seq = t->next_seq++;
+#endif
+  }
+  t->leftmost = list != NULL ? list : t->nil;
+  t->rightmost = last;
+  int height;
+  t->root = rbtree_build_subtree(t, &list, n, &height);
+  t->size = keys;
+}
+
+// 서브트리의 노드들을 key 순서대로 right 포인터로 이어서 리스트 앞에 붙인다. (오른쪽부터 역순 중위순회)
+void rbtree_to_list(const rbtree *t, node_t *node, node_t **list){
+  if (node == t->nil){
+    return;
+  }
+  rbtree_to_list(t, node->right, list);
+  node->right = *list;
+  *list = node;
+  rbtree_to_list(t, node->left, list);
+}
+
+// key 순서로 right 포인터에 연결된 리스트에서 앞의 n개 노드를 꺼내 균형 잡힌 서브트리를 만든다.
+// 가운데 노드를 기준으로 나누면 nil의 깊이가 red_depth 또는 red_depth + 1 이 되기 때문에
+// 깊이가 red_depth인 노드만 RED로 칠하면 모든 경로의 black 노드 수가 같아진다.
+node_t *rbtree_build_from_list(rbtree *t, node_t **list, size_t n, node_t *parent, int depth, int red_depth){
+  if (n == 0){
+    return t->nil;
+  }
+  size_t left_n = (n - 1) / 2;
+  node_t *left = rbtree_build_from_list(t, list, left_n, NULL, depth + 1, red_depth);
+
+  // 왼쪽 서브트리를 다 만들고 나면 리스트의 맨 앞이 현재 서브트리의 루트
+  node_t *node = *list;
+  *list = node->right;
+  rbtree_set_parent(node, parent);
+  rbtree_set_color(node, depth == red_depth ? RBTREE_RED : RBTREE_BLACK);
+  node->left = left;
+  if (left != t->nil){
+    rbtree_set_parent(left, node);
+  }
+  node->right = rbtree_build_from_list(t, list, n - 1 - left_n, node, depth + 1, red_depth);
+#ifdef RBTREE_ORDER_STATS
+  rbtree_update_size(node);
+#endif
+  return node;
+}
+
+static void node_chunks_free(node_chunk_t *chunk){
+  while (chunk != NULL){
+    node_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+}
+
+// 같이 쓰던 chunk 묶음의 참조를 놓는다. 마지막 참조였으면 chunk를 해제하고 이전 묶음의 참조도 놓는다.
+// 나뉜 트리는 다른 thread에서 지워질 수 있으므로 참조 수는 atomic으로 센다.
+static void node_arena_release(node_arena_t *arena){
+  while (arena != NULL && __atomic_sub_fetch(&arena->refs, 1, __ATOMIC_ACQ_REL) == 0){
+    node_arena_t *parent = arena->parents[0];
+    node_chunks_free(arena->chunks);
+    node_arena_release(arena->parents[1]);
+    free(arena);
+    arena = parent;
+  }
 }
 
 void delete_rbtree(rbtree *t) {
-  node_t *node = t->root;
-  // tree의 루트노드가 tree의 nil 노드가 아니라면 key값을 가진 node가 존재한다는 의미로 루트 노드 포함해서 아래 노드 모두 삭제를 위한 함수 실행
-  if (node != t->nil){
-    // tree와 tree의 루트 노트를 입력
-    tree_delete_traverse(t,node);
-  }
-  // 트리의 nil 노드를 할당 해제 해준다.
-  free(t->nil);
-  // 트리를 할당 해제 한다.
+  // 모든 노드는 pool의 chunk 안에 있으므로 트리를 순회하지 않고 chunk 단위로 해제한다.
+  node_chunks_free(t->pool.chunks);
+  node_arena_release(t->pool.arena);
+  // 트리를 할당 해제 한다. (nil은 모든 트리가 같이 씀)
   free(t);
 }
 
@@ -39,31 +198,576 @@ void tree_delete_traverse(rbtree *t, node_t *node){
   if (node->right != t->nil){
     tree_delete_traverse(t,node->right);
   }
-  // 노드를 할당 해제 해준다.
-  free(node);
+  // 노드를 pool에 반환한다.
+  node_free(t,node);
 }
 
-node_t *rbtree_insert(rbtree *t, const key_t key) {
-  // node 동적 할당 calloc으로
-  node_t *new_node = (node_t *)calloc(1,sizeof(node_t));
+// pool에서 노드 하나를 꺼낸다. free list에 재사용할 노드가 있으면 먼저 쓰고, 없으면 chunk에서 bump 할당
+node_t *node_alloc(rbtree *t){
+  node_pool_t *pool = &t->pool;
+#ifdef RBTREE_NO_PARENT
+  // 가득 찬 트리에는 더 넣지 않는다. (seq를 겹치지 않게 매길 수 있는 크기)
+  if (t->size >= RBTREE_SIZE_MAX){
+    return NULL;
+  }
+#endif
+  if (pool->free_list != NULL){
+    node_t *node = pool->free_list;
+    pool->free_list = node->right;
+    RBTREE_STAT_ADD(t, nodes_allocated, 1);
+#ifdef RBTREE_COUNTED
+    node->count = 1;
+#endif
+    return node;
+  }
+  // 맨 앞 chunk가 없거나 다 썼으면 새로운 chunk 할당
+  if (pool->chunks == NULL || pool->chunk_used == pool->chunks->capacity){
+    size_t capacity = NODE_CHUNK_MIN;
+    if (pool->chunks != NULL && pool->chunks->capacity < NODE_CHUNK_MAX){
+      capacity = pool->chunks->capacity * 2;
+    } else if (pool->chunks != NULL){
+      capacity = NODE_CHUNK_MAX;
+    }
+    node_chunk_t *chunk = (node_chunk_t *)malloc(sizeof(node_chunk_t) + capacity * pool->node_size);
+    if (chunk == NULL){
+      return NULL;
+    }
+    chunk->capacity = capacity;
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->chunk_used = 0;
+  }
+  RBTREE_STAT_ADD(t, nodes_allocated, 1);
+  node_t *node = (node_t *)((char *)pool->chunks->nodes + pool->chunk_used++ * pool->node_size);
+#ifdef RBTREE_COUNTED
+  node->count = 1;
+#endif
+  return node;
+}
+
+// 노드를 free list 앞에 넣어서 다음 할당 때 재사용한다.
+void node_free(rbtree *t, node_t *node){
+  RBTREE_STAT_ADD(t, nodes_freed, 1);
+  if (t->pool.free_list == NULL){
+    t->pool.free_tail = node;
+  }
+  node->right = t->pool.free_list;
+  t->pool.free_list = node;
+}
+
+static int chunk_addr_comp(const void *p1, const void *p2){
+  const node_chunk_t *c1 = *(node_chunk_t *const *)p1;
+  const node_chunk_t *c2 = *(node_chunk_t *const *)p2;
+  if (c1 < c2){
+    return -1;
+  }
+  return c1 > c2;
+}
+
+// 노드 주소가 속한 chunk의 index를 이분 탐색으로 찾는다. (chunks는 주소 순으로 정렬되어 있어야 함)
+// 어느 chunk에도 없으면 (다른 트리와 같이 쓰는 chunk의 노드) n
+static size_t chunk_index_of(const node_pool_t *pool, node_chunk_t **chunks, size_t n, const node_t *node){
+  size_t lo = 0, hi = n;
+  while (hi - lo > 1){
+    size_t mid = lo + (hi - lo) / 2;
+    if ((const void *)chunks[mid] <= (const void *)node){
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  const char *begin = (const char *)chunks[lo]->nodes;
+  if ((const char *)node < begin || (const char *)node >= begin + chunks[lo]->capacity * pool->node_size){
+    return n;
+  }
+  return lo;
+}
+
+// 같이 쓰던 chunk 묶음을 이 트리만 참조하고 있으면 그 chunk를 트리의 chunk로 되돌리고 묶음을 없앤다.
+// 아직 다른 트리가 참조하는 묶음은 남겨 두고, 그 참조를 대신 들고 있을 묶음을 돌려준다. (없으면 NULL)
+// 참조 수가 1이면 그 참조는 이 트리의 것이므로 다른 thread가 늘리거나 줄일 수 없다.
+static node_arena_t *node_arena_adopt(node_pool_t *pool, node_arena_t *arena){
+  if (arena == NULL || __atomic_load_n(&arena->refs, __ATOMIC_ACQUIRE) != 1){
+    return arena;
+  }
+  // bump는 계속 맨 앞 chunk에서 하도록 되돌린 chunk는 그 뒤에 붙인다. (맨 앞이 되면 가득 찬 것으로 본다)
+  if (arena->chunks != NULL){
+    node_chunk_t *tail = arena->chunks;
+    while (tail->next != NULL){
+      tail = tail->next;
+    }
+    if (pool->chunks == NULL){
+      pool->chunks = arena->chunks;
+      pool->chunk_used = pool->chunks->capacity;
+    } else {
+      tail->next = pool->chunks->next;
+      pool->chunks->next = arena->chunks;
+    }
+    arena->chunks = NULL;
+  }
+  arena->parents[0] = node_arena_adopt(pool, arena->parents[0]);
+  arena->parents[1] = node_arena_adopt(pool, arena->parents[1]);
+  if (arena->parents[0] != NULL && arena->parents[1] != NULL){
+    return arena;
+  }
+  // 남은 이전 묶음이 하나 이하면 이 묶음의 참조를 그대로 넘기고 묶음은 지운다.
+  node_arena_t *rest = arena->parents[0] != NULL ? arena->parents[0] : arena->parents[1];
+  free(arena);
+  return rest;
+}
+
+// 서브트리의 살아있는 노드를 chunk별로 센다.
+static void chunk_count_live(const rbtree *t, const node_t *node, node_chunk_t **chunks, size_t n, size_t *live){
+  for (; node != t->nil; node = node->right){
+    live[chunk_index_of(&t->pool, chunks, n, node)]++;
+    chunk_count_live(t, node->left, chunks, n, live);
+  }
+}
+
+// 살아있는 노드가 하나도 없는 chunk를 운영체제에 반환한다. 반환한 byte 수를 돌려준다.
+// 살아있는 노드는 주소가 바뀌지 않으므로 노드 포인터는 그대로 유효하다.
+// split으로 나뉜 다른 트리가 모두 지워졌으면 같이 쓰던 chunk도 이 트리의 것으로 되돌려서 대상에 넣는다.
+// 트리의 노드 수에 비례하므로 많이 지운 뒤에 부르는 것이 좋다. O(n log chunk 수)
+size_t rbtree_shrink(rbtree *t){
+  node_pool_t *pool = &t->pool;
+  pool->arena = node_arena_adopt(pool, pool->arena);
+  size_t n = 0;
+  for (node_chunk_t *chunk = pool->chunks; chunk != NULL; chunk = chunk->next){
+    n++;
+  }
+  if (n == 0){
+    return 0;
+  }
+
+  // 마지막 칸은 어느 chunk에도 없는 노드 (아직 다른 트리와 같이 쓰는 chunk의 노드)
+  node_chunk_t **chunks = (node_chunk_t **)malloc(n * sizeof(node_chunk_t *));
+  size_t *live = (size_t *)calloc(n + 1, sizeof(size_t));
+  if (chunks == NULL || live == NULL){
+    free(chunks);
+    free(live);
+    return 0;
+  }
+  node_chunk_t *head = pool->chunks;
+  size_t i = 0;
+  for (node_chunk_t *chunk = head; chunk != NULL; chunk = chunk->next){
+    chunks[i++] = chunk;
+  }
+  qsort(chunks, n, sizeof(node_chunk_t *), chunk_addr_comp);
+
+  // free list 대신 살아있는 노드를 센다. 지워진 다른 트리가 남긴 노드는 어느 free list에도 없기 때문
+  chunk_count_live(t, t->root, chunks, n, live);
+
+  // free list를 다시 만들면서 반환할 chunk에 속한 노드는 빼버린다.
+  node_t *free_list = NULL;
+  node_t *node = pool->free_list;
+  while (node != NULL){
+    node_t *next = node->right;
+    size_t idx = chunk_index_of(pool, chunks, n, node);
+    if (idx == n || live[idx] > 0){
+      if (free_list == NULL){
+        pool->free_tail = node;
+      }
+      node->right = free_list;
+      free_list = node;
+    }
+    node = next;
+  }
+  pool->free_list = free_list;
+
+  // 비어있는 chunk를 목록에서 제거하고 해제
+  size_t released = 0;
+  node_chunk_t **link = &pool->chunks;
+  while (*link != NULL){
+    node_chunk_t *chunk = *link;
+    if (live[chunk_index_of(pool, chunks, n, chunk->nodes)] == 0){
+      *link = chunk->next;
+      released += sizeof(node_chunk_t) + chunk->capacity * pool->node_size;
+      free(chunk);
+    } else {
+      link = &chunk->next;
+    }
+  }
+  // bump 하던 chunk가 해제되었다면 남은 맨 앞 chunk는 이미 가득 찬 상태로 본다.
+  if (pool->chunks != head){
+    pool->chunk_used = pool->chunks != NULL ? pool->chunks->capacity : 0;
+  }
+
+  free(chunks);
+  free(live);
+  return released;
+}
+
+#ifdef RBTREE_NO_PARENT
+// 노드의 순서: key, 같은 key끼리는 seq(넣은 순서). 한 트리 안에서 (key, seq)는 겹치지 않으므로
+// 노드 포인터만 받아도 루트부터 한 번 내려가서 경로를 찾을 수 있다. (합치는 연산은 겹치지 않게 다시 매김)
+// key를 따로 받는 것은 rbtree_update_key가 바꾸기 전의 노드를 새 key로 비교하기 위해서다.
+static bool rbtree_order_before(const key_t a_key, const node_t *a, const key_t b_key, const node_t *b){
+  if (a_key != b_key){
+    return a_key < b_key;
+  }
+  return a->seq < b->seq;
+}
+
+// 루트부터 node까지의 경로를 기록한다. 위의 순서로 한쪽으로만 내려가므로 같은 key가 많아도 O(log n)
+static void rbtree_path_locate(const rbtree *t, const node_t *node, rbtree_path *path){
+  path->len = 0;
+  for (node_t *cur = t->root; cur != t->nil;){
+    path->node[path->len++] = cur;
+    if (cur == node){
+      return;
+    }
+    cur = rbtree_order_before(node->key, node, cur->key, cur) ? cur->left : cur->right;
+  }
+}
+
+// node까지의 경로. 트리에 남겨 둔 경로(finger)가 node에서 끝나면 그대로 쓰고 아니면 새로 찾아서 남긴다.
+static rbtree_path *rbtree_finger_at(rbtree *t, const node_t *node){
+  rbtree_path *finger = &t->finger;
+  if (finger->len == 0 || finger->node[finger->len - 1] != node){
+    rbtree_path_locate(t, node, finger);
+  }
+  return finger;
+}
+
+// 트리의 모양이 바뀌어서 남겨 둔 경로가 맞지 않게 되었다.
+static inline void rbtree_finger_reset(rbtree *t){
+  t->finger.len = 0;
+}
+
+static node_t *rbtree_path_next(const rbtree *t, rbtree_path *path);
+
+// 경로 끝 노드부터 중위순회 순서대로 seq를 새로 매긴다. all이 false면 key와 같은 노드까지만 (경로가 비어 있으면 없음)
+static void rbtree_renumber_from(rbtree *t, rbtree_path *path, const bool all, const key_t key){
+  for (node_t *node = path->len > 0 ? path->node[path->len - 1] : NULL; node != NULL && (all || node->key == key);
+       node = rbtree_path_next(t, path)){
+    node->seq = t->next_seq++;
+  }
+}
+
+// root 서브트리의 seq를 중위순회 순서대로 next_seq부터 매긴다. O(서브트리 크기)
+static void rbtree_renumber_subtree(rbtree *t, node_t *root){
+  rbtree_path path;
+  path.len = 0;
+  for (node_t *cur = root; cur != t->nil; cur = cur->left){
+    path.node[path.len++] = cur;
+  }
+  rbtree_renumber_from(t, &path, true, 0);
+}
+
+// 모든 노드의 seq를 중위순회 순서대로 0부터 다시 매긴다. O(n)
+static void rbtree_renumber_all(rbtree *t){
+  t->next_seq = 0;
+  rbtree_renumber_subtree(t, t->root);
+}
+
+// 새로 넣는 노드의 seq. 트리의 어떤 seq보다도 크므로 같은 key들의 맨 뒤에 들어가는 노드에 맞다.
+// seq를 다 쓰면 먼저 트리 전체를 다시 매긴다. 트리는 RBTREE_SIZE_MAX를 넘지 않으므로
+// 다시 매긴 뒤 적어도 RBTREE_SEQ_MAX / 2번은 넣을 수 있어서 넣기 한 번에 나누면 O(1)
+static unsigned int rbtree_take_seq(rbtree *t){
+  if (t->next_seq >= RBTREE_SEQ_MAX){
+    rbtree_renumber_all(t);
+  }
+  return t->next_seq++;
+}
+
+// key와 같은 노드들의 seq를 순서대로 새로 매긴다. join으로 두 트리의 같은 key가 이어 붙었을 때 순서를 맞춘다.
+// O(log n + 같은 key 수)
+static void rbtree_renumber_key(rbtree *t, const key_t key){
+  // 다 매기기 전에 31bit를 넘을 수 있으면 전체를 매긴다.
+  if (t->size >= RBTREE_SEQ_MAX - t->next_seq){
+    rbtree_renumber_all(t);
+    return;
+  }
+  // lower_bound까지의 경로: key 이상인 노드를 만나 왼쪽으로 간 마지막 자리까지
+  rbtree_path path;
+  path.len = 0;
+  int first = 0;
+  for (node_t *cur = t->root; cur != t->nil;){
+    path.node[path.len++] = cur;
+    if (cur->key < key){
+      cur = cur->right;
+    } else {
+      first = path.len;
+      cur = cur->left;
+    }
+  }
+  path.len = first;
+  rbtree_renumber_from(t, &path, false, key);
+}
+
+// 경로 끝 노드를 중위순회 다음 노드로 옮기고 그 노드를 돌려준다. 없으면 NULL (경로는 비게 됨)
+static node_t *rbtree_path_next(const rbtree *t, rbtree_path *path){
+  node_t *node = path->node[path->len - 1];
+  if (node->right != t->nil){
+    for (node = node->right; node != t->nil; node = node->left){
+      path->node[path->len++] = node;
+    }
+    return path->node[path->len - 1];
+  }
+  // 오른쪽 자식으로 올라오는 동안은 이미 지나간 조상이다.
+  while (path->len > 1 && path->node[path->len - 2]->right == path->node[path->len - 1]){
+    path->len--;
+  }
+  path->len--;
+  return path->len > 0 ? path->node[path->len - 1] : NULL;
+}
+
+static node_t *rbtree_path_prev(const rbtree *t, rbtree_path *path){
+  node_t *node = path->node[path->len - 1];
+  if (node->left != t->nil){
+    for (node = node->left; node != t->nil; node = node->right){
+      path->node[path->len++] = node;
+    }
+    return path->node[path->len - 1];
+  }
+  while (path->len > 1 && path->node[path->len - 2]->left == path->node[path->len - 1]){
+    path->len--;
+  }
+  path->len--;
+  return path->len > 0 ? path->node[path->len - 1] : NULL;
+}
+
+// parent 자리(above의 자식, above가 nil이면 루트)에 자식 node를 올리는 회전. node가 오른쪽 자식이면 rotate_L, 왼쪽이면 rotate_R과 같다.
+static void rbtree_rotate_up(rbtree *t, node_t *above, node_t *parent, node_t *node){
+  if (above == t->nil){
+    t->root = node;
+  } else if (above->left == parent){
+    above->left = node;
+  } else {
+    above->right = node;
+  }
+  if (parent->right == node){
+    RBTREE_STAT_ADD(t, rotations_left, 1);
+    parent->right = node->left;
+    node->left = parent;
+  } else {
+    RBTREE_STAT_ADD(t, rotations_right, 1);
+    parent->left = node->right;
+    node->right = parent;
+  }
+#ifdef RBTREE_ORDER_STATS
+  node->size = parent->size;
+  rbtree_update_size(parent);
+#endif
+}
+
+// rbtree_insert_fixup과 같은 case를 부모 대신 경로로 처리한다. path->node[at]이 RED인 노드 (처음에는 경로 끝의 새 노드)
+// 회전한 뒤에도 경로가 끝 노드까지 이어지도록 고쳐 두므로, 이어지는 삽입이 finger로 그대로 쓸 수 있다.
+static void rbtree_insert_fixup_path(rbtree *t, rbtree_path *path, const int at){
+  node_t *node = path->node[at];
+  RBTREE_STAT_ADD(t, insert_fixup_calls, 1);
+#ifdef RBTREE_STATS
+  if (node->left == t->nil && node->right == t->nil){
+    t->stats.fixup_depth = 0;
+  }
+#endif
+  RBTREE_STAT_DEPTH(t, insert_fixup_depth_max);
+  if (at == 0){
+    rbtree_set_color(node, RBTREE_BLACK);
+    return;
+  }
+  node_t *parent_node = path->node[at - 1];
+  if (rbtree_color(parent_node) == RBTREE_BLACK){
+    return;
+  }
+  // RED인 부모는 루트가 아니므로 조부모가 항상 있다.
+  node_t *grand_parent_node = path->node[at - 2];
+  node_t *above = at > 2 ? path->node[at - 3] : t->nil;
+  const bool is_left_node = node == parent_node->left;
+  const bool is_left_parent_node = parent_node == grand_parent_node->left;
+  node_t *uncle_node = is_left_parent_node ? grand_parent_node->right : grand_parent_node->left;
+
+  // case 1: 색만 바꾸고 조부모에서 다시
+  if (rbtree_color(uncle_node) == RBTREE_RED){
+    RBTREE_STAT_ADD(t, insert_fixup_cases[0], 1);
+    rbtree_set_color(parent_node, RBTREE_BLACK);
+    rbtree_set_color(uncle_node, RBTREE_BLACK);
+    rbtree_set_color(grand_parent_node, RBTREE_RED);
+    rbtree_insert_fixup_path(t, path, at - 2);
+    return;
+  }
+  node_t *top;
+  if (is_left_node == is_left_parent_node){
+    // case 3: 곧은 모양이면 부모를 조부모 자리로. 경로에서는 조부모가 빠진다.
+    RBTREE_STAT_ADD(t, insert_fixup_cases[2], 1);
+    rbtree_rotate_up(t, above, grand_parent_node, parent_node);
+    top = parent_node;
+    memmove(&path->node[at - 2], &path->node[at - 1], (size_t)(path->len - at + 1) * sizeof(node_t *));
+    path->len--;
+  } else {
+    // case 2: 꺾인 모양이면 노드를 두 번 올린다. 노드의 옛 자식은 부모나 조부모 밑으로 가므로 경로도 그쪽으로
+    RBTREE_STAT_ADD(t, insert_fixup_cases[1], 1);
+    rbtree_rotate_up(t, grand_parent_node, parent_node, node);
+    rbtree_rotate_up(t, above, grand_parent_node, node);
+    top = node;
+    path->node[at - 2] = node;
+    if (at + 1 < path->len){
+      node_t *child = path->node[at + 1];
+      path->node[at - 1] = parent_node->left == child || parent_node->right == child ? parent_node : grand_parent_node;
+      memmove(&path->node[at], &path->node[at + 1], (size_t)(path->len - at - 1) * sizeof(node_t *));
+      path->len--;
+    } else {
+      path->len -= 2;
+    }
+  }
+  rbtree_set_color(top, RBTREE_BLACK);
+  rbtree_set_color(grand_parent_node, RBTREE_RED);
+}
+
+// rbtree_erase_fixup과 같은 case를 경로로 처리한다. 경로 끝이 검은색이 모자란 자리의 부모
+static void rbtree_erase_fixup_path(rbtree *t, rbtree_path *path, const bool is_node_left){
+  RBTREE_STAT_ADD(t, erase_fixup_calls, 1);
+  RBTREE_STAT_DEPTH(t, erase_fixup_depth_max);
+  node_t *parent_node = path->node[path->len - 1];
+  node_t *above = path->len > 1 ? path->node[path->len - 2] : t->nil;
+  node_t *extra_black = is_node_left ? parent_node->left : parent_node->right;
+  if (rbtree_color(extra_black) == RBTREE_RED){
+    rbtree_set_color(extra_black, RBTREE_BLACK);
+    return;
+  }
+  node_t *sibling_node = is_node_left ? parent_node->right : parent_node->left;
+  node_t *near = is_node_left ? sibling_node->left : sibling_node->right;
+  node_t *distant = is_node_left ? sibling_node->right : sibling_node->left;
+
+  // Case 1) 형제가 RED: 형제를 부모 자리로 올리고 (경로에서도 부모 위에 끼워 넣고) 다시
+  if (rbtree_color(sibling_node) == RBTREE_RED){
+    RBTREE_STAT_ADD(t, erase_fixup_cases[0], 1);
+    rbtree_rotate_up(t, above, parent_node, sibling_node);
+    exchange_color(sibling_node, parent_node);
+    path->node[path->len - 1] = sibling_node;
+    path->node[path->len++] = parent_node;
+    rbtree_erase_fixup_path(t, path, is_node_left);
+    return;
+  }
+  // Case 3) 가까운 조카만 RED: 조카를 형제 자리로 올리고 다시
+  if (rbtree_color(near) == RBTREE_RED && rbtree_color(distant) == RBTREE_BLACK){
+    RBTREE_STAT_ADD(t, erase_fixup_cases[2], 1);
+    rbtree_rotate_up(t, parent_node, sibling_node, near);
+    exchange_color(sibling_node, near);
+    rbtree_erase_fixup_path(t, path, is_node_left);
+    return;
+  }
+  // Case 4) 먼 조카가 RED: 형제를 부모 자리로 올리고 끝
+  if (rbtree_color(distant) == RBTREE_RED){
+    RBTREE_STAT_ADD(t, erase_fixup_cases[3], 1);
+    rbtree_rotate_up(t, above, parent_node, sibling_node);
+    exchange_color(sibling_node, parent_node);
+    rbtree_set_color(distant, RBTREE_BLACK);
+    return;
+  }
+  // Case 2) 형제를 RED로 바꾸고 부모에서 다시
+  RBTREE_STAT_ADD(t, erase_fixup_cases[1], 1);
+  rbtree_set_color(sibling_node, RBTREE_RED);
+  if (path->len > 1){
+    const bool is_parent_left = above->left == parent_node;
+    path->len--;
+    rbtree_erase_fixup_path(t, path, is_parent_left);
+  }
+}
+#endif
+
+// key가 정해진 노드를 parent의 빈 자식 자리에 붙이고 균형을 맞춘다. (위치는 호출하는 쪽이 이미 정한 상태)
+static void rbtree_link_node(rbtree *t, node_t *parent, const bool is_left, node_t *new_node){
+#ifdef RBTREE_NO_PARENT
+  // 붙이는 자리는 같은 key들의 맨 뒤이므로 가장 큰 seq
+  new_node->seq = rbtree_take_seq(t);
+#endif
+  rbtree_set_color(new_node, RBTREE_RED);
+  new_node->left = new_node->right = t->nil;
+  rbtree_set_parent(new_node, parent);
+  if (is_left){
+    parent->left = new_node;
+    if (parent == t->leftmost){
+      t->leftmost = new_node;
+    }
+  } else {
+    parent->right = new_node;
+    if (parent == t->rightmost){
+      t->rightmost = new_node;
+    }
+  }
+#ifdef RBTREE_NO_PARENT
+  // 부모 포인터 대신 parent까지의 경로를 쓴다. 호출하는 쪽이 내려오면서 (또는 바로 전 삽입이) 남긴 경로가
+  // parent에서 끝나면 다시 찾지 않는다.
+  rbtree_path *path = rbtree_finger_at(t, parent);
+  path->node[path->len++] = new_node;
+#endif
+#ifdef RBTREE_ORDER_STATS
+  // 서브트리 크기는 루트까지 올라가며 늘려야 하므로 이 option에서는 O(log n)
+  new_node->size = 1;
+#ifdef RBTREE_NO_PARENT
+  for (int i = 0; i < path->len - 1; i++){
+    path->node[i]->size++;
+  }
+#else
+  for (node_t *node = parent; node != t->nil; node = rbtree_parent(node)){
+    node->size++;
+  }
+#endif
+#endif
+  t->size++;
+#ifdef RBTREE_NO_PARENT
+  rbtree_insert_fixup_path(t, path, path->len - 1);
+#else
+  rbtree_insert_fixup(t, new_node);
+#endif
+}
+
+static node_t *rbtree_link_new(rbtree *t, node_t *parent, const bool is_left, const key_t key){
+  node_t *new_node = node_alloc(t);
+  if (new_node == NULL){
+    return NULL;
+  }
+  new_node->key = key;
+  rbtree_link_node(t, parent, is_left, new_node);
+  return new_node;
+}
+
+// key가 정해진 노드를 루트부터 내려가서 들어갈 자리에 넣는다. (새 노드 또는 rbtree_detach로 떼어낸 노드)
+static void rbtree_insert_node(rbtree *t, node_t *new_node){
+  const key_t key = new_node->key;
+  // 가장 큰 key 이상이면 내려가지 않고 맨 오른쪽 노드 뒤에 바로 붙인다. (증가하는 key를 넣는 경우)
+  if (t->rightmost != t->nil && key >= t->rightmost->key){
+    RBTREE_STAT_ADD(t, comparisons, 1);
+    rbtree_link_node(t, t->rightmost, false, new_node);
+    return;
+  }
   // new_node 는 처음에 RED로 무조건 설정
-  new_node->color = RBTREE_RED;
+  rbtree_set_color(new_node, RBTREE_RED);
   // 왼쪽과 오른쪽은 nil 노드로 설정
   new_node->left = new_node->right = t->nil;
-  // key 값(현재의 숫자)으로 설정
-  new_node->key = key;
+#ifdef RBTREE_ORDER_STATS
+  new_node->size = 1;
+#endif
   
   // 현재노드를 루트 노드로 설정
   node_t *current_node = t->root;
+#ifdef RBTREE_NO_PARENT
+  // 내려가는 경로를 finger에 기록해 두었다가 fixup이 부모 대신 쓴다. (같은 key는 오른쪽으로 가므로 가장 큰 seq)
+  new_node->seq = rbtree_take_seq(t);
+  rbtree_path *path = &t->finger;
+  path->len = 0;
+#endif
   
   // 만약 현재 노드가 nil 노드를 안가리킬 때 까지
   while (current_node != t->nil){
+    RBTREE_STAT_ADD(t, comparisons, 1);
+#ifdef RBTREE_NO_PARENT
+    path->node[path->len++] = current_node;
+#endif
+#ifdef RBTREE_ORDER_STATS
+    // 지나가는 노드는 모두 새 노드를 서브트리에 포함하게 된다.
+    current_node->size++;
+#endif
     // key값이 현재노드의 값보다 작으면
     if (key < current_node->key){
       // 현재 노드의 왼쪽 노드가 nil 노드를 가리킨다면
       if (current_node->left == t->nil){
         // 현재 노드의 왼쪽을 new_node로 지정 후 끝내기
         current_node->left = new_node;
+        if (current_node == t->leftmost){
+          t->leftmost = new_node;
+        }
         break;
       }
       // 현재 노드를 현재 노드의 왼쪽으로 (왼쪽 탐색)
@@ -77,237 +781,1626 @@ node_t *rbtree_insert(rbtree *t, const key_t key) {
         current_node->right = new_node;
         break;
       }
-      // 현재 노드를 현재노드의 오른쪽으로 지정 (오른쪽 탐색)
-      current_node = current_node->right;
+      // 현재 노드를 현재노드의 오른쪽으로 지정 (오른쪽 탐색)
+      current_node = current_node->right;
+    }
+  }
+  //새로운 노드의 부모를 현재 노드로 설정.
+  rbtree_set_parent(new_node, current_node);
+  // 만약 현재노드의 값이 nil 노드라면 (루트노드가 nil노드라면 트리에 nil노드 외에 아무 노드도 없다는 뜻이기에)
+  if (current_node == t->nil){
+    // 트리의 루트 노드를 new_node로 지정
+    t->root = new_node;
+    t->leftmost = t->rightmost = new_node;
+  }
+  t->size++;
+  // 삽입 case 1,2,3 확인
+#ifdef RBTREE_NO_PARENT
+  path->node[path->len++] = new_node;
+  rbtree_insert_fixup_path(t, path, path->len - 1);
+#else
+  rbtree_insert_fixup(t,new_node);
+#endif
+}
+
+#ifdef RBTREE_COUNTED
+#ifdef RBTREE_ORDER_STATS
+// node부터 루트까지 서브트리 크기를 delta만큼 바꾼다.
+static void rbtree_add_size(rbtree *t, node_t *node, const int delta){
+#ifdef RBTREE_NO_PARENT
+  // 방금 찾은 노드면 찾으며 남긴 경로를 그대로 쓴다.
+  const rbtree_path *path = rbtree_finger_at(t, node);
+  for (int i = 0; i < path->len; i++){
+    path->node[i]->size += delta;
+  }
+#else
+  for (node_t *p = node; p != t->nil; p = rbtree_parent(p)){
+    p->size += delta;
+  }
+#endif
+}
+#endif
+
+// 이미 있는 노드의 count를 하나 늘린다. 같은 key마다 노드를 할당하지 않으므로 메모리는 서로 다른 key 수에 비례한다.
+static node_t *rbtree_count_add(rbtree *t, node_t *node){
+  node->count++;
+  t->size++;
+#ifdef RBTREE_ORDER_STATS
+  rbtree_add_size(t, node, 1);
+#endif
+  return node;
+}
+
+// count를 하나 줄인다. 마지막 하나라서 노드를 떼어내야 하면 줄이지 않고 false
+static bool rbtree_count_sub(rbtree *t, node_t *node){
+  if (node->count == 1){
+    return false;
+  }
+  node->count--;
+  t->size--;
+#ifdef RBTREE_ORDER_STATS
+  rbtree_add_size(t, node, -1);
+#endif
+  return true;
+}
+#endif
+
+// key와 같은 노드를 찾으면 그 노드를 돌려주고 found를 true로, 없으면 찾으며 내려간 자리에 새 노드를 붙인다.
+// 찾기와 삽입을 한 번 내려가면서 하므로 이미 있는 key에는 노드를 할당하지 않는다. 할당에 실패하면 NULL
+static node_t *rbtree_find_or_link(rbtree *t, const key_t key, bool *found){
+  // 가장 큰 key 이상이면 내려가지 않는다. (증가하는 key를 넣는 경우)
+  if (t->rightmost != t->nil && key >= t->rightmost->key){
+    RBTREE_STAT_ADD(t, comparisons, 1);
+    *found = key == t->rightmost->key;
+    return *found ? t->rightmost : rbtree_link_new(t, t->rightmost, false, key);
+  }
+  *found = false;
+  node_t *parent = t->nil;
+  node_t *node = t->root;
+  bool is_left = false;
+#ifdef RBTREE_NO_PARENT
+  // 내려가는 경로를 finger에 남겨서, 찾은 노드의 count를 늘리거나 parent에 붙일 때 다시 찾지 않는다.
+  rbtree_path *path = &t->finger;
+  path->len = 0;
+#endif
+  while (node != t->nil){
+    RBTREE_STAT_ADD(t, comparisons, 1);
+#ifdef RBTREE_NO_PARENT
+    path->node[path->len++] = node;
+#endif
+    if (key == node->key){
+      *found = true;
+      return node;
+    }
+    parent = node;
+    is_left = key < node->key;
+    node = is_left ? node->left : node->right;
+  }
+  if (parent != t->nil){
+    return rbtree_link_new(t, parent, is_left, key);
+  }
+  // 빈 트리면 루트로
+  node_t *new_node = node_alloc(t);
+  if (new_node == NULL){
+    return NULL;
+  }
+  new_node->key = key;
+  rbtree_insert_node(t, new_node);
+  return new_node;
+}
+
+node_t *rbtree_insert(rbtree *t, const key_t key) {
+#ifdef RBTREE_COUNTED
+  // 같은 key가 있으면 새 노드 대신 그 노드의 count를 늘린다.
+  bool found;
+  node_t *node = rbtree_find_or_link(t, key, &found);
+  return found ? rbtree_count_add(t, node) : node;
+#else
+  // node는 tree의 pool에서 할당
+  node_t *new_node = node_alloc(t);
+  if (new_node == NULL){
+    return NULL;
+  }
+  // key 값(현재의 숫자)으로 설정
+  new_node->key = key;
+  rbtree_insert_node(t, new_node);
+  return new_node;
+#endif
+}
+
+// key가 이미 있으면 넣지 않고 (RBTREE_COUNTED에서도 count를 늘리지 않고) 있던 노드를 돌려준다.
+// 없으면 새로 넣은 노드를 돌려주고, 할당에 실패하면 NULL
+node_t *rbtree_insert_unique(rbtree *t, const key_t key){
+  bool found;
+  return rbtree_find_or_link(t, key, &found);
+}
+
+// hint 옆 parent 자리에 key를 붙인다. RBTREE_COUNTED에서 이웃 노드 same이 같은 key면 새 노드 대신 count를 늘린다.
+static node_t *rbtree_link_beside(rbtree *t, node_t *parent, const bool is_left, const key_t key, node_t *same){
+#ifdef RBTREE_COUNTED
+  if (same != NULL && same->key == key){
+    return rbtree_count_add(t, same);
+  }
+#else
+  (void)same;
+#endif
+  return rbtree_link_new(t, parent, is_left, key);
+}
+
+#ifdef RBTREE_NO_PARENT
+// node의 다음(next가 true) 또는 이전 노드. rbtree_next/rbtree_prev와 달리 finger를 node에 그대로 두므로
+// 이웃을 본 뒤 node에 붙이거나 node를 떼어낼 때 경로를 다시 찾지 않는다.
+static node_t *rbtree_neighbor(rbtree *t, const node_t *node, const bool next){
+  const rbtree_path *path = rbtree_finger_at(t, node);
+  node_t *child = next ? node->right : node->left;
+  if (child != t->nil){
+    while ((next ? child->left : child->right) != t->nil){
+      child = next ? child->left : child->right;
+    }
+    return child;
+  }
+  // 반대쪽 자식으로 올라오는 동안은 건너뛴다.
+  for (int i = path->len - 1; i > 0; i--){
+    node_t *up = path->node[i - 1];
+    if ((next ? up->left : up->right) == path->node[i]){
+      return up;
+    }
+  }
+  return NULL;
+}
+
+// node의 next 쪽 자식 서브트리에서 node와 가장 가까운 노드. finger를 그 노드까지 이어 내려가므로 거기에 바로 붙일 수 있다.
+static node_t *rbtree_nearest_below(rbtree *t, node_t *node, const bool next){
+  rbtree_path *path = rbtree_finger_at(t, node);
+  for (node = next ? node->right : node->left; node != t->nil; node = next ? node->left : node->right){
+    path->node[path->len++] = node;
+  }
+  return path->node[path->len - 1];
+}
+
+// 같은 key끼리는 seq 순서로 놓이므로 새 노드(가장 큰 seq)는 같은 key들의 맨 뒤, 즉 key가 더 큰 노드 앞에만 들어갈 수 있다.
+// (RBTREE_COUNTED에서는 같은 key면 새 노드 대신 count를 늘리므로 상관없음)
+static inline bool rbtree_fits_before(const key_t key, const node_t *next){
+#ifdef RBTREE_COUNTED
+  return key <= next->key;
+#else
+  return key < next->key;
+#endif
+}
+#else
+static node_t *rbtree_neighbor(rbtree *t, const node_t *node, const bool next){
+  return next ? rbtree_next(t, node) : rbtree_prev(t, node);
+}
+
+static node_t *rbtree_nearest_below(rbtree *t, node_t *node, const bool next){
+  node = next ? node->right : node->left;
+  while ((next ? node->left : node->right) != t->nil){
+    node = next ? node->left : node->right;
+  }
+  return node;
+}
+
+static inline bool rbtree_fits_before(const key_t key, const node_t *next){
+  return key <= next->key;
+}
+#endif
+
+// hint 노드 바로 앞이나 뒤에 key가 들어갈 수 있으면 루트부터 내려가지 않고 그 자리에 넣는다.
+// 이웃 노드만 보므로 순서대로 넣을 때 평균 O(1) + 균형 맞추기
+// hint가 맞지 않으면 (또는 NULL이면) rbtree_insert와 같다.
+node_t *rbtree_insert_hint(rbtree *t, node_t *hint, const key_t key){
+  if (hint == NULL){
+    return rbtree_insert(t, key);
+  }
+  RBTREE_STAT_ADD(t, comparisons, 2);
+#ifdef RBTREE_COUNTED
+  if (key == hint->key){
+    return rbtree_count_add(t, hint);
+  }
+#endif
+  if (key >= hint->key){
+    // hint와 다음 노드 사이: hint의 오른쪽이 비어 있으면 거기, 아니면 다음 노드(오른쪽 서브트리의 최소)의 왼쪽
+    if (hint->right == t->nil){
+      node_t *next = hint == t->rightmost ? NULL : rbtree_neighbor(t, hint, true);
+      if (next == NULL || rbtree_fits_before(key, next)){
+        return rbtree_link_beside(t, hint, false, key, next);
+      }
+    } else {
+      node_t *next = rbtree_nearest_below(t, hint, true);
+      if (rbtree_fits_before(key, next)){
+        return rbtree_link_beside(t, next, true, key, next);
+      }
+    }
+  } else {
+    // 이전 노드와 hint 사이: hint의 왼쪽이 비어 있으면 거기, 아니면 이전 노드(왼쪽 서브트리의 최대)의 오른쪽
+    if (hint->left == t->nil){
+      node_t *prev = hint == t->leftmost ? NULL : rbtree_neighbor(t, hint, false);
+      if (prev == NULL || key >= prev->key){
+        return rbtree_link_beside(t, hint, true, key, prev);
+      }
+    } else {
+      node_t *prev = rbtree_nearest_below(t, hint, false);
+      if (key >= prev->key){
+        return rbtree_link_beside(t, prev, false, key, prev);
+      }
+    }
+  }
+  return rbtree_insert(t, key);
+}
+
+static int key_comp(const void *p1, const void *p2){
+  const key_t k1 = *(const key_t *)p1;
+  const key_t k2 = *(const key_t *)p2;
+  return (k1 > k2) - (k1 < k2);
+}
+
+// batch가 트리 크기의 1/BATCH_REBUILD_RATIO 이상이면 하나씩 넣지 않고 병합 후 다시 만든다.
+#define BATCH_REBUILD_RATIO 8
+
+// key 묶음을 정렬한 뒤 트리에 합친다. 삽입한 key 수를 반환한다.
+// 기존 노드들은 주소가 바뀌지 않는다. (다시 만드는 경우에도 노드를 재연결만 함)
+size_t rbtree_insert_batch(rbtree *t, const key_t *keys, const size_t n){
+  if (n == 0){
+    return 0;
+  }
+  key_t *sorted = (key_t *)malloc(n * sizeof(key_t));
+  if (sorted == NULL){
+    return 0;
+  }
+  memcpy(sorted, keys, n * sizeof(key_t));
+  qsort(sorted, n, sizeof(key_t), key_comp);
+
+  size_t inserted = 0;
+  // batch가 작으면 정렬된 순서로 하나씩 삽입 (이웃한 key끼리 같은 경로를 타서 cache에 유리)
+  if (n * BATCH_REBUILD_RATIO < t->size){
+    for (; inserted < n; inserted++){
+      if (rbtree_insert(t, sorted[inserted]) == NULL){
+        break;
+      }
+    }
+    free(sorted);
+    return inserted;
+  }
+
+  // batch가 크면 기존 노드 리스트와 새 노드 리스트를 병합해서 O(size + n)에 트리를 다시 만든다.
+  node_t *old_list = NULL;
+  rbtree_to_list(t, t->root, &old_list);
+
+  node_t *new_list = NULL;
+  for (size_t i = n; i > 0; i--){
+#ifdef RBTREE_COUNTED
+    if (new_list != NULL && new_list->key == sorted[i - 1]){
+      new_list->count++;
+      inserted++;
+      continue;
+    }
+#endif
+#ifdef RBTREE_NO_PARENT
+    // 트리가 가득 차는 것도 할당 실패와 같게 본다.
+    if (t->size + inserted >= RBTREE_SIZE_MAX){
+      break;
+    }
+#endif
+    node_t *node = node_alloc(t);
+    if (node == NULL){
+      // 할당에 실패하면 지금까지 만든 (뒤쪽 key들의) 노드만 넣는다.
+      break;
+    }
+    node->key = sorted[i - 1];
+    node->right = new_list;
+    new_list = node;
+    inserted++;
+  }
+  free(sorted);
+
+  node_t head;
+  node_t *tail = &head;
+  size_t nodes = 0;
+  while (old_list != NULL && new_list != NULL){
+#ifdef RBTREE_COUNTED
+    // 기존 노드와 같은 key면 새 노드를 반환하고 기존 노드의 count에 더한다.
+    if (new_list->key == old_list->key){
+      node_t *next = new_list->right;
+      old_list->count += new_list->count;
+      node_free(t, new_list);
+      new_list = next;
+      continue;
+    }
+#endif
+    // 같은 key면 기존 노드가 먼저 (rbtree_insert처럼 같은 key는 오른쪽에 붙는다)
+    if (new_list->key < old_list->key){
+      tail->right = new_list;
+      new_list = new_list->right;
+    } else {
+      tail->right = old_list;
+      old_list = old_list->right;
+    }
+    tail = tail->right;
+    nodes++;
+  }
+  tail->right = old_list != NULL ? old_list : new_list;
+  for (node_t *node = tail->right; node != NULL; node = node->right){
+    nodes++;
+  }
+
+  rbtree_rebuild_from_list(t, head.right, nodes);
+  return inserted;
+}
+
+#ifndef RBTREE_NO_PARENT
+void rbtree_insert_fixup(rbtree *t, node_t *node){
+  RBTREE_STAT_ADD(t, insert_fixup_calls, 1);
+#ifdef RBTREE_STATS
+  // 재귀로 올라온 노드는 자식이 있으므로, 새 leaf로 들어오면 새 삽입의 fixup이 시작된 것
+  if (node->left == t->nil && node->right == t->nil){
+    t->stats.fixup_depth = 0;
+  }
+#endif
+  RBTREE_STAT_DEPTH(t, insert_fixup_depth_max);
+  // 만약 노드가 루트 노드라면 컬러를 규칙 #2번에 따라 루트 노드의 색을 블랙으로 변경
+  if (node == t->root){
+    rbtree_set_color(node, RBTREE_BLACK);
+    return;
+  }
+  node_t *parent_node = rbtree_parent(node);
+  bool is_left_node = node == parent_node->left; 
+
+  // 만약 부모의 노드가 검은색이면 속성 위반이 없기에 그냥 끝.
+  if (rbtree_color(parent_node) == RBTREE_BLACK){
+    return;
+  }
+
+  node_t *grand_parent_node = rbtree_parent(parent_node); 
+  bool is_left_parent_node = parent_node == grand_parent_node->left;
+
+  node_t *uncle_node;
+
+  if (is_left_parent_node){
+    uncle_node = grand_parent_node->right;
+  }else{
+    uncle_node = grand_parent_node->left;
+  }
+
+  // case 1 실행 (만약 삼촌이 빨간색 노드라면)
+  if (rbtree_color(uncle_node) == RBTREE_RED){
+    RBTREE_STAT_ADD(t, insert_fixup_cases[0], 1);
+    rbtree_set_color(parent_node, RBTREE_BLACK);
+    rbtree_set_color(uncle_node, RBTREE_BLACK);
+    rbtree_set_color(grand_parent_node, RBTREE_RED);
+    rbtree_insert_fixup(t,grand_parent_node);
+    return;
+  }
+
+  // 부모의 노드가 조부모의 왼쪽일때
+  if(is_left_parent_node){
+    if(is_left_node){ // 부모가 왼쪽 자식이고 현재 노드가 왼쪽자식일때 -> case 3
+      RBTREE_STAT_ADD(t, insert_fixup_cases[2], 1);
+      rotate_R(t,parent_node); // rotated 공부하기
+      rbtree_set_color(parent_node, RBTREE_BLACK);
+      rbtree_set_color(parent_node->right, RBTREE_RED);
+      return;
+    }else{ // 부모가 왼쪽 자식이고 현재 노드가 오른쪽자식일때 -> case 2
+      RBTREE_STAT_ADD(t, insert_fixup_cases[1], 1);
+      rotate_L(t,node);
+      rotate_R(t,node);
+      rbtree_set_color(node, RBTREE_BLACK);
+      rbtree_set_color(node->right, RBTREE_RED);
+      return;
+    }
+  }
+  // 부모의 노드가 조부모의 오른쪽일때
+  else{
+    if(is_left_node){ // 부모가 오른쪽 자식이고 현재 노드가 왼쪽자식일때 -> case 2
+      RBTREE_STAT_ADD(t, insert_fixup_cases[1], 1);
+      rotate_R(t,node);
+      rotate_L(t,node);
+      rbtree_set_color(node, RBTREE_BLACK);
+      rbtree_set_color(node->left, RBTREE_RED);
+      return;
+    }else{ // 부모가 오른쪽 자식이고 현재 노드가 오른쪽자식일떄 -> case 3
+      RBTREE_STAT_ADD(t, insert_fixup_cases[2], 1);
+      rotate_L(t,parent_node);
+      rbtree_set_color(parent_node, RBTREE_BLACK);
+      rbtree_set_color(parent_node->left, RBTREE_RED);
+      return;
+    }
+  }
+}
+
+void rotate_L(rbtree *t,node_t *node){
+  RBTREE_STAT_ADD(t, rotations_left, 1);
+  node_t *parent_node = rbtree_parent(node);
+  node_t *grand_parent_node = rbtree_parent(parent_node);
+  node_t *left_node = node->left;
+
+  // 부모 노드가 루트 노드였다면
+  if (parent_node == t->root){
+    // 루트 노드를 노드로 한다.
+    t->root = node;
+  } else {
+    // 조부모의 노드의 왼쪽에 부모 노드라면 그 자리를 노드로 넣기 위해 if 문 사용
+    if (grand_parent_node->left == parent_node){
+      grand_parent_node->left = node;
+    } else {
+      grand_parent_node->right = node;
+    }
+  }
+  // 노드의 부모를 조부모로 바로 연결 (G <-> N 양방향 연결)
+  rbtree_set_parent(node, grand_parent_node);
+  // 부모 노드를 노드의 왼쪽 자식으로 설정 하기 (P <-> N 양방향 연결)
+  rbtree_set_parent(parent_node, node);
+  node->left = parent_node;                                        
+  // 노드의 원래의 왼쪽 자식은 부모의 오른쪽 자식으로 설정해야함. 
+  parent_node->right = left_node;
+  if (left_node != t->nil){
+    rbtree_set_parent(left_node, parent_node);
+  }
+#ifdef RBTREE_ORDER_STATS
+  // 노드가 부모의 자리를 그대로 차지하므로 서브트리 크기도 물려받고, 부모는 자식들로 다시 계산
+  node->size = parent_node->size;
+  rbtree_update_size(parent_node);
+#endif                                                                                                                                                                                                                                                                                                           
+}
+
+void rotate_R(rbtree *t,node_t *node){
+  RBTREE_STAT_ADD(t, rotations_right, 1);
+  node_t *parent_node = rbtree_parent(node);
+  node_t *grand_parent_node = rbtree_parent(parent_node);
+  node_t *right_node = node->right;
+
+  // 부모 노드가 루트 노드였다면
+  if (parent_node == t->root){
+    // 루트 노드를 노드로 한다.
+    t->root = node;
+  } else {
+    // 조부모의 노드의 왼쪽에 부모 노드라면 그 자리를 노드로 넣기 위해 if 문 사용
+    if (grand_parent_node->left == parent_node){
+      grand_parent_node->left = node;
+    } else {
+      grand_parent_node->right = node;
+    }
+  }
+  // 노드의 부모를 조부모로 바로 연결 (G <-> N 양방향 연결)
+  rbtree_set_parent(node, grand_parent_node);
+  // 부모 노드를 노드의 오른쪽 자식으로 설정 하기 (P <-> N 양방향 연결)
+  rbtree_set_parent(parent_node, node);
+  node->right = parent_node;
+  if (right_node != t->nil){
+    rbtree_set_parent(right_node, parent_node);
+  }
+  // 노드의 원래의 오른쪽 자식은 부모의 왼쪽 자식으로 설정해야함. 
+  parent_node->left = right_node;    
+#ifdef RBTREE_ORDER_STATS
+  node->size = parent_node->size;
+  rbtree_update_size(parent_node);
+#endif
+}
+#endif
+
+node_t *rbtree_find(const rbtree *t, const key_t key) {
+  node_t *current_node = t->root;
+  while (current_node != t->nil){
+    RBTREE_STAT_ADD(t, comparisons, 1);
+    if (current_node->key == key){
+      return current_node;
+    } else if (key < current_node->key){
+      current_node = current_node->left;
+    } else {
+      current_node = current_node->right;
+    }
+  }
+  return NULL;
+}
+
+// rbtree_find_batch가 번갈아 진행하는 탐색 수. 동시에 기다릴 수 있는 cache miss 수(core당 10~20개) 정도면 충분하다.
+#define RBTREE_BATCH_WIDTH 16
+
+// keys[i]를 rbtree_find로 찾은 결과를 out[i]에 넣고 찾은 수를 반환한다. (같은 key가 여러 개여도 rbtree_find와 같은 노드)
+// 탐색 여러 개를 한 level씩 번갈아 내려가면서 내려갈 자식을 prefetch 해 두므로, 한 탐색이 기다리는 동안 다른 탐색의
+// miss가 같이 진행된다. 끝난 탐색의 자리에는 바로 다음 key를 넣어서 탐색마다 깊이가 달라도 자리가 놀지 않는다.
+size_t rbtree_find_batch(const rbtree *t, const key_t *keys, const size_t n, node_t **out){
+  node_t *nodes[RBTREE_BATCH_WIDTH];
+  size_t index[RBTREE_BATCH_WIDTH];
+  size_t next = 0;
+  size_t found = 0;
+  int active = 0;
+  while (active < RBTREE_BATCH_WIDTH && next < n){
+    nodes[active] = t->root;
+    index[active++] = next++;
+  }
+  while (active > 0){
+    for (int i = 0; i < active;){
+      node_t *node = nodes[i];
+      const key_t key = keys[index[i]];
+      if (node != t->nil){
+        RBTREE_STAT_ADD(t, comparisons, 1);
+        if (node->key != key){
+          node = key < node->key ? node->left : node->right;
+          __builtin_prefetch(node);
+          nodes[i++] = node;
+          continue;
+        }
+      }
+      // 이 탐색은 끝났다. 남은 key가 있으면 이 자리에서 새로 시작하고, 없으면 마지막 자리를 당겨 온다.
+      out[index[i]] = node != t->nil ? node : NULL;
+      found += node != t->nil;
+      if (next < n){
+        nodes[i] = t->root;
+        index[i++] = next++;
+      } else {
+        active--;
+        nodes[i] = nodes[active];
+        index[i] = index[active];
+      }
+    }
+  }
+  return found;
+}
+
+// 양 끝 노드는 트리에 저장해 두므로 O(1). 비어 있으면 NULL
+node_t *rbtree_min(const rbtree *t) {
+  return t->leftmost != t->nil ? t->leftmost : NULL;
+}
+
+node_t *rbtree_max(const rbtree *t) {
+  return t->rightmost != t->nil ? t->rightmost : NULL;
+}
+
+#ifndef RBTREE_NO_PARENT
+// u 자리에 v 서브트리를 연결한다. (u의 자식은 건드리지 않음)
+static void rbtree_transplant(rbtree *t, node_t *u, node_t *v){
+  node_t *parent = rbtree_parent(u);
+  if (parent == t->nil){
+    t->root = v;
+  } else if (parent->left == u){
+    parent->left = v;
+  } else {
+    parent->right = v;
+  }
+  if (v != t->nil){
+    rbtree_set_parent(v, parent);
+  }
+}
+
+// 노드를 트리에서 떼어내고 균형을 맞춘다. 노드는 해제하지 않으며 다른 노드의 key도 바꾸지 않는다.
+// 자식이 둘이면 key를 복사하는 대신 successor 노드를 통째로 node 자리로 옮긴다.
+static void rbtree_detach(rbtree *t, node_t *node){
+  if (node == t->leftmost){
+    node_t *next = rbtree_next(t, node);
+    t->leftmost = next != NULL ? next : t->nil;
+  }
+  if (node == t->rightmost){
+    node_t *prev = rbtree_prev(t, node);
+    t->rightmost = prev != NULL ? prev : t->nil;
+  }
+
+  color_t removed_color = rbtree_color(node);
+  node_t *fix_parent;  // 검은색이 하나 모자라게 되는 자리의 부모
+  bool fix_left;
+  if (node->left == t->nil || node->right == t->nil){
+    node_t *child = node->left != t->nil ? node->left : node->right;
+    fix_parent = rbtree_parent(node);
+    fix_left = fix_parent != t->nil && fix_parent->left == node;
+    rbtree_transplant(t, node, child);
+  } else {
+    node_t *successor = rbtree_successor_find(t, node->right);
+    removed_color = rbtree_color(successor);
+    if (rbtree_parent(successor) == node){
+      fix_parent = successor;
+      fix_left = false;
+    } else {
+      fix_parent = rbtree_parent(successor);
+      fix_left = true;
+      rbtree_transplant(t, successor, successor->right);
+      successor->right = node->right;
+      rbtree_set_parent(successor->right, successor);
+    }
+    rbtree_transplant(t, node, successor);
+    successor->left = node->left;
+    rbtree_set_parent(successor->left, successor);
+    rbtree_set_color(successor, rbtree_color(node));
+  }
+  t->size -= rbtree_node_count(node);
+#ifdef RBTREE_ORDER_STATS
+  // 바뀐 경로는 fix_parent부터 루트까지뿐이다. (자식이 둘이면 옮겨 간 successor도 이 경로 위에 있음)
+  for (node_t *p = fix_parent; p != t->nil; p = rbtree_parent(p)){
+    rbtree_update_size(p);
+  }
+#endif
+
+  if (fix_parent == t->nil){
+    // 루트가 빠졌으면 새 루트만 검은색으로
+    if (t->root != t->nil){
+      rbtree_set_color(t->root, RBTREE_BLACK);
+    }
+  } else if (removed_color == RBTREE_BLACK){
+#ifdef RBTREE_STATS
+    t->stats.fixup_depth = 0;
+#endif
+    rbtree_erase_fixup(t, fix_parent, fix_left);
+  }
+}
+
+#else
+// parent의 자식 u 자리에 v 서브트리를 연결한다. (parent가 nil이면 루트)
+static void rbtree_replace_child(rbtree *t, node_t *parent, node_t *u, node_t *v){
+  if (parent == t->nil){
+    t->root = v;
+  } else if (parent->left == u){
+    parent->left = v;
+  } else {
+    parent->right = v;
+  }
+}
+
+// 부모 포인터 없이 노드를 떼어낸다. node까지의 경로(finger)를 자식이 둘이면 successor까지 이어 내려가고
+// 위의 rbtree_detach와 같은 방식으로 successor 노드를 node 자리로 옮긴 뒤 경로를 fixup에 넘긴다.
+static void rbtree_detach(rbtree *t, node_t *node){
+  rbtree_path *path = rbtree_finger_at(t, node);
+  const int at = path->len - 1;  // 경로에서 node의 위치
+  node_t *parent = at > 0 ? path->node[at - 1] : t->nil;
+  // 가장 작은 노드는 왼쪽 자식이 없으므로 다음 노드는 오른쪽 서브트리의 최소 아니면 부모 (가장 큰 노드도 대칭)
+  if (node == t->leftmost){
+    t->leftmost = node->right != t->nil ? rbtree_successor_find(t, node->right) : parent;
+  }
+  if (node == t->rightmost){
+    node_t *prev = node->left;
+    while (prev != t->nil && prev->right != t->nil){
+      prev = prev->right;
+    }
+    t->rightmost = prev != t->nil ? prev : parent;
+  }
+
+  color_t removed_color = rbtree_color(node);
+  bool fix_left;
+  if (node->left == t->nil || node->right == t->nil){
+    node_t *child = node->left != t->nil ? node->left : node->right;
+    fix_left = parent != t->nil && parent->left == node;
+    rbtree_replace_child(t, parent, node, child);
+    path->len--;
+  } else {
+    for (node_t *cur = node->right; cur != t->nil; cur = cur->left){
+      path->node[path->len++] = cur;
+    }
+    node_t *successor = path->node[--path->len];
+    removed_color = rbtree_color(successor);
+    if (successor == node->right){
+      fix_left = false;
+    } else {
+      fix_left = true;
+      path->node[path->len - 1]->left = successor->right;
+      successor->right = node->right;
+    }
+    rbtree_replace_child(t, parent, node, successor);
+    successor->left = node->left;
+    rbtree_set_color(successor, rbtree_color(node));
+    // 경로에서도 node 자리를 successor가 차지한다. (successor가 node의 오른쪽 자식이었으면 경로 끝이 successor)
+    path->node[at] = successor;
+  }
+  t->size -= rbtree_node_count(node);
+#ifdef RBTREE_ORDER_STATS
+  for (int i = path->len - 1; i >= 0; i--){
+    rbtree_update_size(path->node[i]);
+  }
+#endif
+
+  if (path->len == 0){
+    if (t->root != t->nil){
+      rbtree_set_color(t->root, RBTREE_BLACK);
+    }
+  } else if (removed_color == RBTREE_BLACK){
+#ifdef RBTREE_STATS
+    t->stats.fixup_depth = 0;
+#endif
+    rbtree_erase_fixup_path(t, path, fix_left);
+  }
+  // 회전과 successor 이동으로 경로가 맞지 않게 되었다.
+  rbtree_finger_reset(t);
+}
+#endif
+
+// 노드를 떼어내고 pool에 돌려준다. 자식이 둘이어도 successor의 key를 옮겨 오지 않고 successor 노드를 그 자리로 옮기므로
+// 지우는 노드 말고는 모든 노드의 주소와 내용이 그대로다. (다른 노드의 포인터를 들고 있어도 다시 찾을 필요가 없음)
+int rbtree_erase(rbtree *t, node_t *check_node) {
+#ifdef RBTREE_COUNTED
+  // 같은 key가 더 남아 있으면 count만 줄인다.
+  if (rbtree_count_sub(t, check_node)){
+    return 0;
+  }
+#endif
+  rbtree_detach(t, check_node);
+  node_free(t, check_node);
+  return 0;
+}
+
+// 노드의 key를 바꾼다. 이웃한 key 사이에 그대로 있으면 제자리에서 바꾸고,
+// 아니면 떼어냈다가 같은 노드를 다시 넣는다. 노드를 해제하거나 새로 할당하지 않으므로 포인터는 그대로 유효하다.
+// RBTREE_COUNTED에서는 key 하나만 옮기므로 count가 남은 노드는 그대로 두고, 새 key가 이미 있으면 그 노드에 합친다.
+// 이때는 반환된 노드가 key를 가진 노드다. 새 key의 노드를 할당하지 못하면 NULL이고 node의 count와 트리는 그대로다.
+node_t *rbtree_update_key(rbtree *t, node_t *node, const key_t key){
+#ifdef RBTREE_COUNTED
+  if (key != node->key && node->count > 1){
+    // 새 key를 먼저 넣어야 할당에 실패했을 때 옛 key 하나를 잃지 않는다. (다른 key라서 node의 count는 그대로)
+    node_t *moved = rbtree_insert(t, key);
+    if (moved != NULL){
+      rbtree_count_sub(t, node);
+    }
+    return moved;
+  }
+#endif
+  node_t *prev = node == t->leftmost ? NULL : rbtree_neighbor(t, node, false);
+  node_t *next = node == t->rightmost ? NULL : rbtree_neighbor(t, node, true);
+#ifdef RBTREE_NO_PARENT
+  // 같은 key끼리는 seq 순서이므로 key만이 아니라 seq까지 이웃 사이에 있어야 제자리에 둘 수 있다.
+  bool fits = (prev == NULL || rbtree_order_before(prev->key, prev, key, node)) &&
+              (next == NULL || rbtree_order_before(key, node, next->key, next));
+#else
+  bool fits = (prev == NULL || prev->key <= key) && (next == NULL || key <= next->key);
+#endif
+#ifdef RBTREE_COUNTED
+  // 이웃과 같은 key가 되면 제자리에 두지 않고 그 이웃 노드에 합친다.
+  fits = fits && (key == node->key || ((prev == NULL || prev->key != key) && (next == NULL || next->key != key)));
+#endif
+  if (fits){
+    node->key = key;
+    return node;
+  }
+  rbtree_detach(t, node);
+#ifdef RBTREE_COUNTED
+  node_t *same = rbtree_find(t, key);
+  if (same != NULL){
+    node_free(t, node);
+    return rbtree_count_add(t, same);
+  }
+#endif
+  node->key = key;
+  rbtree_insert_node(t, node);
+  return node;
+}
+
+// 가장 작은 key를 꺼내서 지운다. 비어 있으면 false
+// 최소 노드는 왼쪽 자식이 없으므로 찾거나 key를 복사할 필요 없이 바로 떼어낸다.
+bool rbtree_pop_min(rbtree *t, key_t *key){
+  if (t->leftmost == t->nil){
+    return false;
+  }
+  node_t *node = t->leftmost;
+  *key = node->key;
+#ifdef RBTREE_COUNTED
+  if (rbtree_count_sub(t, node)){
+    return true;
+  }
+#endif
+  rbtree_detach(t, node);
+  node_free(t, node);
+  return true;
+}
+
+// 가장 큰 key를 꺼내서 지운다. 비어 있으면 false
+bool rbtree_pop_max(rbtree *t, key_t *key){
+  if (t->rightmost == t->nil){
+    return false;
+  }
+  node_t *node = t->rightmost;
+  *key = node->key;
+#ifdef RBTREE_COUNTED
+  if (rbtree_count_sub(t, node)){
+    return true;
+  }
+#endif
+  rbtree_detach(t, node);
+  node_free(t, node);
+  return true;
+}
+
+// 서브트리의 black height: 서브트리 루트부터 nil까지 지나는 검은 노드 수 (nil은 0).
+// 모든 경로의 검은 노드 수가 같으므로 왼쪽 끝 경로만 센다.
+static int rbtree_black_height(const rbtree *t, const node_t *node){
+  int height = 0;
+  for (; node != t->nil; node = node->left){
+    if (rbtree_color(node) == RBTREE_BLACK){
+      height++;
+    }
+  }
+  return height;
+}
+
+// left의 모든 key <= mid->key <= right의 모든 key 인 두 서브트리를 mid로 이어 붙이고 새 루트를 돌려준다.
+// 두 서브트리의 black height를 받아서 결과의 black height를 height에 돌려준다.
+// 높이가 큰 쪽의 가장자리를 따라 내려가서 작은 쪽과 높이가 같은 검은 노드 자리에 mid를 RED로 넣고
+// 삽입 fixup으로 맞춘다. O(두 높이의 차 + 1)
+// fixup의 회전이 루트를 바꿀 수 있으므로 그동안 t->root를 높은 쪽 서브트리의 루트로 바꿔 두고 쓴다.
+static node_t *rbtree_join_nodes(rbtree *t, node_t *left, int left_height, node_t *mid, node_t *right, int right_height, int *height){
+  // 루트는 검은색으로 바꿔도 규칙이 깨지지 않는다. (nil은 이미 검은색)
+  if (rbtree_color(left) == RBTREE_RED){
+    rbtree_set_color(left, RBTREE_BLACK);
+    left_height++;
+  }
+  if (rbtree_color(right) == RBTREE_RED){
+    rbtree_set_color(right, RBTREE_BLACK);
+    right_height++;
+  }
+
+  if (left_height == right_height){
+    mid->left = left;
+    mid->right = right;
+    if (left != t->nil){
+      rbtree_set_parent(left, mid);
+    }
+    if (right != t->nil){
+      rbtree_set_parent(right, mid);
+    }
+    rbtree_set_parent(mid, t->nil);
+    rbtree_set_color(mid, RBTREE_BLACK);
+#ifdef RBTREE_ORDER_STATS
+    rbtree_update_size(mid);
+#endif
+    *height = left_height + 1;
+    return mid;
+  }
+
+  bool is_left = left_height < right_height;
+  node_t *top = is_left ? right : left;
+  node_t *parent = t->nil;
+  node_t *node = top;
+  node_t *other = is_left ? left : right;
+  int node_height = is_left ? right_height : left_height;
+  const int other_height = is_left ? left_height : right_height;
+#ifdef RBTREE_NO_PARENT
+  rbtree_path path;
+  path.len = 0;
+  rbtree_finger_reset(t);
+#endif
+  // 높은 쪽의 안쪽 가장자리에서 낮은 쪽과 높이가 같은 검은 노드를 찾는다.
+  while (rbtree_color(node) == RBTREE_RED || node_height != other_height){
+    if (rbtree_color(node) == RBTREE_BLACK){
+      node_height--;
+    }
+#ifdef RBTREE_NO_PARENT
+    path.node[path.len++] = node;
+#endif
+#ifdef RBTREE_ORDER_STATS
+    node->size += other->size + rbtree_node_count(mid);
+#endif
+    parent = node;
+    node = is_left ? node->left : node->right;
+  }
+  if (is_left){
+    parent->left = mid;
+    mid->left = other;
+    mid->right = node;
+  } else {
+    parent->right = mid;
+    mid->left = node;
+    mid->right = other;
+  }
+  if (mid->left != t->nil){
+    rbtree_set_parent(mid->left, mid);
+  }
+  if (mid->right != t->nil){
+    rbtree_set_parent(mid->right, mid);
+  }
+  rbtree_set_parent(mid, parent);
+  rbtree_set_color(mid, RBTREE_RED);
+#ifdef RBTREE_ORDER_STATS
+  rbtree_update_size(mid);
+#endif
+
+  // 높이는 case 1이 루트까지 올라가서 루트의 두 RED 자식을 검은색으로 바꿨을 때만 1 늘어난다.
+  // (루트에서 회전이 일어나면 루트가 바뀌고 높이는 그대로)
+  const bool red_children = rbtree_color(top->left) == RBTREE_RED && rbtree_color(top->right) == RBTREE_RED;
+  t->root = top;
+#ifdef RBTREE_STATS
+  t->stats.fixup_depth = 0;
+#endif
+#ifdef RBTREE_NO_PARENT
+  path.node[path.len++] = mid;
+  rbtree_insert_fixup_path(t, &path, path.len - 1);
+#else
+  rbtree_insert_fixup(t, mid);
+#endif
+  *height = is_left ? right_height : left_height;
+  if (t->root == top && red_children && rbtree_color(top->left) == RBTREE_BLACK && rbtree_color(top->right) == RBTREE_BLACK){
+    (*height)++;
+  }
+  return t->root;
+}
+
+// 서브트리를 key 기준으로 둘로 나눈다. upper가 false면 key보다 작은 노드가, true면 key 이하인 노드가 left로 간다.
+// 내려가는 경로에서 떨어져 나온 서브트리들을 아래에서부터 join으로 붙인다. join 비용이 높이 차이라서 합쳐도 O(log n)
+static void rbtree_split_node(rbtree *t, node_t *node, const int height, const key_t key, const bool upper,
+                              node_t **left, int *left_height, node_t **right, int *right_height){
+  if (node == t->nil){
+    *left = *right = t->nil;
+    *left_height = *right_height = 0;
+    return;
+  }
+  const int child_height = height - (rbtree_color(node) == RBTREE_BLACK);
+  node_t *left_child = node->left;
+  node_t *right_child = node->right;
+  if (left_child != t->nil){
+    rbtree_set_parent(left_child, t->nil);
+  }
+  if (right_child != t->nil){
+    rbtree_set_parent(right_child, t->nil);
+  }
+  node_t *middle;
+  int middle_height;
+  if (node->key < key || (upper && node->key == key)){
+    rbtree_split_node(t, right_child, child_height, key, upper, &middle, &middle_height, right, right_height);
+    *left = rbtree_join_nodes(t, left_child, child_height, node, middle, middle_height, left_height);
+  } else {
+    rbtree_split_node(t, left_child, child_height, key, upper, left, left_height, &middle, &middle_height);
+    *right = rbtree_join_nodes(t, middle, middle_height, node, right_child, child_height, right_height);
+  }
+}
+
+#if defined(RBTREE_NO_PARENT) && !defined(RBTREE_COUNTED)
+// rbtree_split_node와 같지만 key 대신 pivot 노드를 기준으로 (key, seq) 순서에서 앞인 노드를 left로 보낸다.
+// union이 두 트리의 같은 key 노드를 이 순서대로 섞어 두어야 나중에 노드 포인터로 경로를 찾을 수 있다.
+static void rbtree_split_before(rbtree *t, node_t *node, const int height, const node_t *pivot,
+                                node_t **left, int *left_height, node_t **right, int *right_height){
+  if (node == t->nil){
+    *left = *right = t->nil;
+    *left_height = *right_height = 0;
+    return;
+  }
+  const int child_height = height - (rbtree_color(node) == RBTREE_BLACK);
+  node_t *left_child = node->left;
+  node_t *right_child = node->right;
+  node_t *middle;
+  int middle_height;
+  if (rbtree_order_before(node->key, node, pivot->key, pivot)){
+    rbtree_split_before(t, right_child, child_height, pivot, &middle, &middle_height, right, right_height);
+    *left = rbtree_join_nodes(t, left_child, child_height, node, middle, middle_height, left_height);
+  } else {
+    rbtree_split_before(t, left_child, child_height, pivot, left, left_height, &middle, &middle_height);
+    *right = rbtree_join_nodes(t, middle, middle_height, node, right_child, child_height, right_height);
+  }
+}
+#endif
+
+// 서브트리에서 가장 오른쪽 노드를 떼어내서 last에 넘기고 나머지의 루트와 높이를 돌려준다.
+static node_t *rbtree_split_last(rbtree *t, node_t *node, const int height, node_t **last, int *rest_height){
+  const int child_height = height - (rbtree_color(node) == RBTREE_BLACK);
+  node_t *left_child = node->left;
+  node_t *right_child = node->right;
+  if (left_child != t->nil){
+    rbtree_set_parent(left_child, t->nil);
+  }
+  if (right_child == t->nil){
+    *last = node;
+    *rest_height = child_height;
+    return left_child;
+  }
+  rbtree_set_parent(right_child, t->nil);
+  int height_right;
+  node_t *rest = rbtree_split_last(t, right_child, child_height, last, &height_right);
+  return rbtree_join_nodes(t, left_child, child_height, node, rest, height_right, rest_height);
+}
+
+// key 순서로 left 다음에 right가 오는 두 서브트리를 하나로 잇는다. (pivot 노드가 없으면 left의 마지막 노드를 씀)
+static node_t *rbtree_concat_nodes(rbtree *t, node_t *left, const int left_height, node_t *right, const int right_height, int *height){
+  if (left == t->nil){
+    *height = right_height;
+    return right;
+  }
+  if (right == t->nil){
+    *height = left_height;
+    return left;
+  }
+  node_t *last;
+  int rest_height;
+  left = rbtree_split_last(t, left, left_height, &last, &rest_height);
+  return rbtree_join_nodes(t, left, rest_height, last, right, right_height, height);
+}
+
+// 새로 만든 루트를 트리에 건다.
+static void rbtree_set_root(rbtree *t, node_t *root){
+#ifdef RBTREE_NO_PARENT
+  rbtree_finger_reset(t);
+#endif
+  t->root = root;
+  if (root != t->nil){
+    rbtree_set_parent(root, t->nil);
+    rbtree_set_color(root, RBTREE_BLACK);
+  }
+}
+
+// 떼어낸 서브트리의 노드를 key 순서대로 fn에 넘기면서 pool에 돌려주고 key 수를 센다. (count가 있으면 그만큼 fn을 부름)
+static size_t rbtree_free_subtree(rbtree *t, node_t *node, void (*fn)(key_t, void *), void *ctx){
+  size_t count = 0;
+  while (node != t->nil){
+    count += rbtree_free_subtree(t, node->left, fn, ctx);
+    const size_t copies = rbtree_node_count(node);
+    for (size_t i = 0; fn != NULL && i < copies; i++){
+      fn(node->key, ctx);
+    }
+    node_t *right = node->right;
+    node_free(t, node);
+    count += copies;
+    node = right;
+  }
+  return count;
+}
+
+// [lo, hi] 범위의 key를 모두 지우고 지운 개수를 돌려준다.
+size_t rbtree_erase_range(rbtree *t, const key_t lo, const key_t hi){
+  return rbtree_erase_range_fn(t, lo, hi, NULL, NULL);
+}
+
+// 지우는 key를 작은 것부터 fn에 넘긴다. (fn이 NULL이면 넘기지 않음)
+// 노드마다 지우며 fixup을 돌리는 대신 범위 앞뒤에서 트리를 잘라 가운데를 통째로 떼어내고 양쪽을 한 번 이어 붙인다.
+// 자르고 붙이는 데 O(log n), 떼어낸 k개를 해제하는 데 O(k)
+size_t rbtree_erase_range_fn(rbtree *t, const key_t lo, const key_t hi, void (*fn)(key_t, void *), void *ctx){
+  node_t *first = hi < lo ? NULL : rbtree_lower_bound(t, lo);
+  if (first == NULL || hi < first->key){
+    return 0;
+  }
+  node_t *before = first == t->leftmost ? NULL : rbtree_prev(t, first);
+  node_t *after = rbtree_upper_bound(t, hi);
+
+  node_t *less, *rest, *range, *greater;
+  int less_height, rest_height, range_height, greater_height;
+  rbtree_split_node(t, t->root, rbtree_black_height(t, t->root), lo, false, &less, &less_height, &rest, &rest_height);
+  rbtree_split_node(t, rest, rest_height, hi, true, &range, &range_height, &greater, &greater_height);
+  int height;
+  rbtree_set_root(t, rbtree_concat_nodes(t, less, less_height, greater, greater_height, &height));
+
+  // 범위가 한쪽 끝까지 닿았으면 범위 바로 바깥의 노드가 새 끝
+  if (before == NULL){
+    t->leftmost = after != NULL ? after : t->nil;
+  }
+  if (after == NULL){
+    t->rightmost = before != NULL ? before : t->nil;
+  }
+  size_t removed = rbtree_free_subtree(t, range, fn, ctx);
+  t->size -= removed;
+  return removed;
+}
+
+// 두 트리의 pool을 합친다. 나눌 때 같이 쓰게 된 chunk 묶음은 참조를 합치고, right만 가진 chunk와 free list는 left로 옮긴다.
+// 묶음을 새로 만들 수 없으면 -1 (둘 다 그대로)
+static int rbtree_pool_merge(rbtree *left, rbtree *right){
+  node_pool_t *pool = &left->pool;
+  node_pool_t *other = &right->pool;
+  if (other->arena != NULL && pool->arena != NULL && other->arena != pool->arena){
+    node_arena_t *arena = (node_arena_t *)malloc(sizeof(node_arena_t));
+    if (arena == NULL){
+      return -1;
+    }
+    arena->refs = 1;
+    arena->chunks = NULL;
+    arena->parents[0] = pool->arena;
+    arena->parents[1] = other->arena;
+    pool->arena = arena;
+  } else if (other->arena != NULL && pool->arena == NULL){
+    pool->arena = other->arena;
+  } else if (other->arena != NULL){
+    // 같은 묶음이면 left의 참조 하나로 충분하다.
+    node_arena_release(other->arena);
+  }
+
+  // right의 chunk는 left의 bump chunk 뒤에 붙인다. (bump는 계속 left의 맨 앞 chunk에서)
+  if (other->chunks != NULL){
+    if (pool->chunks == NULL){
+      pool->chunks = other->chunks;
+      pool->chunk_used = other->chunk_used;
+    } else {
+      node_chunk_t *tail = other->chunks;
+      while (tail->next != NULL){
+        tail = tail->next;
+      }
+      tail->next = pool->chunks->next;
+      pool->chunks->next = other->chunks;
     }
   }
-  //새로운 노드의 부모를 현재 노드로 설정.
-  new_node->parent = current_node;
-  // 만약 현재노드의 값이 nil 노드라면 (루트노드가 nil노드라면 트리에 nil노드 외에 아무 노드도 없다는 뜻이기에)
-  if (current_node == t->nil){
-    // 트리의 루트 노드를 new_node로 지정
-    t->root = new_node;
+  if (other->free_list != NULL){
+    other->free_tail->right = pool->free_list;
+    if (pool->free_list == NULL){
+      pool->free_tail = other->free_tail;
+    }
+    pool->free_list = other->free_list;
   }
-  // 삽입 case 1,2,3 확인
-  rbtree_insert_fixup(t,new_node);
-  return new_node;
+  return 0;
 }
 
-void rbtree_insert_fixup(rbtree *t, node_t *node){
-  // 만약 노드가 루트 노드라면 컬러를 규칙 #2번에 따라 루트 노드의 색을 블랙으로 변경
-  if (node == t->root){
-    node->color = RBTREE_BLACK;
-    return;
+#ifdef RBTREE_ORDER_STATS
+// t를 key보다 작은 key의 트리(left)와 key 이상인 key의 트리(right)로 나눈다.
+// 노드는 복사하지 않고 자른 경로를 black height에 맞춰 다시 붙이므로 O(log n).
+// 나뉜 두 트리의 key 수는 잘린 left 쪽 루트의 서브트리 크기로 바로 알 수 있어야 하므로 RBTREE_ORDER_STATS에서만 있다.
+// (서브트리 크기가 없으면 한쪽을 세는 데 O(min(left, right))가 든다.)
+// t는 left로 다시 쓰고 right는 새로 만든다. 두 트리는 지금까지의 chunk를 같이 쓰고 새 노드는 각자의 chunk에 할당한다.
+// 실패하면 -1 (t는 그대로)
+int rbtree_split(rbtree *t, const key_t key, rbtree **left, rbtree **right){
+  rbtree *other = new_rbtree();
+  node_arena_t *arena = (node_arena_t *)malloc(sizeof(node_arena_t));
+  if (other == NULL || arena == NULL){
+    free(other);
+    free(arena);
+    return -1;
   }
-  node_t *parent_node = node->parent;
-  bool is_left_node = node == parent_node->left; 
-
-  // 만약 부모의 노드가 검은색이면 속성 위반이 없기에 그냥 끝.
-  if (parent_node->color == RBTREE_BLACK){
-    return;
+  // 지금까지의 chunk는 두 트리가 같이 쓰는 묶음으로 옮긴다. 맨 앞 chunk에서 아직 bump 하지 않은 노드는 t의 free list로 넘긴다.
+  // chunk 하나에 한 번뿐이고 chunk는 그 전의 할당 수만큼만 커지므로 할당 한 번에 나누면 O(1)
+  node_chunk_t *front = t->pool.chunks;
+  for (size_t i = t->pool.chunk_used; front != NULL && i < front->capacity; i++){
+    node_t *node = (node_t *)((char *)front->nodes + i * t->pool.node_size);
+    if (t->pool.free_list == NULL){
+      t->pool.free_tail = node;
+    }
+    node->right = t->pool.free_list;
+    t->pool.free_list = node;
   }
+  arena->refs = 2;
+  arena->chunks = t->pool.chunks;
+  arena->parents[0] = t->pool.arena;
+  arena->parents[1] = NULL;
+  t->pool.chunks = NULL;
+  t->pool.chunk_used = 0;
+  t->pool.arena = other->pool.arena = arena;
+  other->pool.node_size = t->pool.node_size;
+#ifdef RBTREE_NO_PARENT
+  other->next_seq = t->next_seq;
+#endif
 
-  node_t *grand_parent_node = parent_node->parent; 
-  bool is_left_parent_node = parent_node == grand_parent_node->left;
+  node_t *first = rbtree_lower_bound(t, key);
+  node_t *last = first == NULL ? rbtree_max(t) : rbtree_prev(t, first);
 
-  node_t *uncle_node;
+  node_t *less, *greater;
+  int less_height, greater_height;
+  rbtree_split_node(t, t->root, rbtree_black_height(t, t->root), key, false, &less, &less_height, &greater, &greater_height);
+  rbtree_set_root(t, less);
+  rbtree_set_root(other, greater);
+  const size_t left_size = less->size;
+  other->size = t->size - left_size;
+  t->size = left_size;
+  other->leftmost = first != NULL ? first : t->nil;
+  other->rightmost = first != NULL ? t->rightmost : t->nil;
+  t->leftmost = last != NULL ? t->leftmost : t->nil;
+  t->rightmost = last != NULL ? last : t->nil;
+  *left = t;
+  *right = other;
+  return 0;
+}
+#endif
 
-  if (is_left_parent_node){
-    uncle_node = grand_parent_node->right;
-  }else{
-    uncle_node = grand_parent_node->left;
+// left의 모든 key가 right의 모든 key 이하일 때 두 트리를 O(log n)에 합친다.
+// 결과는 left이고 right는 해제된다. 순서가 맞지 않거나 노드 크기가 다르면 NULL (둘 다 그대로)
+// RBTREE_NO_PARENT에서는 합친 크기가 RBTREE_SIZE_MAX를 넘어도 NULL
+rbtree *rbtree_join(rbtree *left, rbtree *right){
+  if (left->pool.node_size != right->pool.node_size ||
+      (left->size > 0 && right->size > 0 && right->leftmost->key < left->rightmost->key)){
+    return NULL;
   }
-
-  // case 1 실행 (만약 삼촌이 빨간색 노드라면)
-  if (uncle_node->color == RBTREE_RED){
-    parent_node->color = RBTREE_BLACK;
-    uncle_node->color = RBTREE_BLACK;
-    grand_parent_node->color = RBTREE_RED;
-    rbtree_insert_fixup(t,grand_parent_node);
-    return;
+#ifdef RBTREE_NO_PARENT
+  if (left->size + right->size > RBTREE_SIZE_MAX){
+    return NULL;
   }
-
-  // 부모의 노드가 조부모의 왼쪽일때
-  if(is_left_parent_node){
-    if(is_left_node){ // 부모가 왼쪽 자식이고 현재 노드가 왼쪽자식일때 -> case 3
-      rotate_R(t,parent_node); // rotated 공부하기
-      parent_node->color = RBTREE_BLACK;
-      parent_node->right->color = RBTREE_RED;
-      return;
-    }else{ // 부모가 왼쪽 자식이고 현재 노드가 오른쪽자식일때 -> case 2
-      rotate_L(t,node);
-      rotate_R(t,node);
-      node->color = RBTREE_BLACK;
-      node->right->color = RBTREE_RED;
-      return;
-    }
+#endif
+  if (rbtree_pool_merge(left, right) != 0){
+    return NULL;
   }
-  // 부모의 노드가 조부모의 오른쪽일때
-  else{
-    if(is_left_node){ // 부모가 오른쪽 자식이고 현재 노드가 왼쪽자식일때 -> case 2
-      rotate_R(t,node);
-      rotate_L(t,node);
-      node->color = RBTREE_BLACK;
-      node->left->color = RBTREE_RED;
-      return;
-    }else{ // 부모가 오른쪽 자식이고 현재 노드가 오른쪽자식일떄 -> case 3
-      rotate_L(t,parent_node);
-      parent_node->color = RBTREE_BLACK;
-      parent_node->left->color = RBTREE_RED;
-      return;
+#ifdef RBTREE_NO_PARENT
+  // 경계에 같은 key가 양쪽에 있으면 이어 붙인 뒤 그 key의 seq를 순서대로 다시 매긴다.
+  const bool same_key = left->size > 0 && right->size > 0 && left->rightmost->key == right->leftmost->key;
+  const key_t boundary = same_key ? right->leftmost->key : 0;
+  if (right->next_seq > left->next_seq){
+    left->next_seq = right->next_seq;
+  }
+#endif
+  int height;
+  rbtree_set_root(left, rbtree_concat_nodes(left, left->root, rbtree_black_height(left, left->root),
+                                            right->root, rbtree_black_height(right, right->root), &height));
+  if (right->size > 0){
+    if (left->size == 0){
+      left->leftmost = right->leftmost;
     }
+    left->rightmost = right->rightmost;
   }
+  left->size += right->size;
+#ifdef RBTREE_NO_PARENT
+  if (same_key){
+    rbtree_renumber_key(left, boundary);
+  }
+#endif
+  free(right);
+  return left;
 }
 
-void rotate_L(rbtree *t,node_t *node){
-  node_t *parent_node = node->parent;
-  node_t *grand_parent_node = parent_node->parent;
-  node_t *left_node = node->left;
+// left의 모든 key <= key <= right의 모든 key 일 때 key를 가운데에 넣으면서 두 트리를 합친다.
+// 새 노드가 바로 pivot이 되므로 left의 마지막 노드를 떼어낼 필요가 없다. 실패하면 NULL (둘 다 그대로)
+rbtree *rbtree_join_key(rbtree *left, const key_t key, rbtree *right){
+  if (left->pool.node_size != right->pool.node_size ||
+      (left->size > 0 && key < left->rightmost->key) || (right->size > 0 && right->leftmost->key < key)){
+    return NULL;
+  }
+#ifdef RBTREE_NO_PARENT
+  if (left->size + right->size >= RBTREE_SIZE_MAX){
+    return NULL;
+  }
+#endif
+  node_t *mid = node_alloc(left);
+  if (mid == NULL){
+    return NULL;
+  }
+  if (rbtree_pool_merge(left, right) != 0){
+    node_free(left, mid);
+    return NULL;
+  }
+  mid->key = key;
+#ifdef RBTREE_NO_PARENT
+  // mid는 left의 같은 key보다 뒤이고, right 앞쪽에 같은 key가 있으면 이어 붙인 뒤 그 key의 seq를 다시 매긴다.
+  const bool same_key = right->size > 0 && right->leftmost->key == key;
+  if (right->next_seq > left->next_seq){
+    left->next_seq = right->next_seq;
+  }
+  mid->seq = rbtree_take_seq(left);
+#endif
+  int height;
+  rbtree_set_root(left, rbtree_join_nodes(left, left->root, rbtree_black_height(left, left->root), mid,
+                                          right->root, rbtree_black_height(right, right->root), &height));
+  left->leftmost = left->size > 0 ? left->leftmost : mid;
+  left->rightmost = right->size > 0 ? right->rightmost : mid;
+  left->size += right->size + 1;
+#ifdef RBTREE_NO_PARENT
+  if (same_key){
+    rbtree_renumber_key(left, key);
+  }
+#endif
+  free(right);
+  return left;
+}
 
-  // 부모 노드가 루트 노드였다면
-  if (parent_node == t->root){
-    // 루트 노드를 노드로 한다.
-    t->root = node;
-  } else {
-    // 조부모의 노드의 왼쪽에 부모 노드라면 그 자리를 노드로 넣기 위해 if 문 사용
-    if (grand_parent_node->left == parent_node){
-      grand_parent_node->left = node;
-    } else {
-      grand_parent_node->right = node;
-    }
+// 루트가 바뀐 뒤 양 끝 노드를 다시 찾는다. O(log n)
+static void rbtree_reset_extremes(rbtree *t){
+  node_t *lo = t->root, *hi = t->root;
+  while (lo != t->nil && lo->left != t->nil){
+    lo = lo->left;
   }
-  // 노드의 부모를 조부모로 바로 연결 (G <-> N 양방향 연결)
-  node->parent = grand_parent_node;
-  // 부모 노드를 노드의 왼쪽 자식으로 설정 하기 (P <-> N 양방향 연결)
-  parent_node->parent = node;
-  node->left = parent_node;                                        
-  // 노드의 원래의 왼쪽 자식은 부모의 오른쪽 자식으로 설정해야함. 
-  parent_node->right = left_node;
-  left_node->parent = parent_node;                                                                                                                                                                                                                                                                                                           
+  while (hi != t->nil && hi->right != t->nil){
+    hi = hi->right;
+  }
+  t->leftmost = lo;
+  t->rightmost = hi;
 }
 
-void rotate_R(rbtree *t,node_t *node){
-  node_t *parent_node = node->parent;
-  node_t *grand_parent_node = parent_node->parent;
-  node_t *right_node = node->right;
+// 서브트리에서 key와 같은 노드를 모두 떼어내서 key 순서 리스트로 넘기고 key 수를 돌려준다. 나머지는 less와 greater로 나뉜다.
+// 같은 key가 없으면 두 번째 split은 하지 않는다.
+static size_t rbtree_split_equal(rbtree *t, node_t *node, const int height, const key_t key, node_t **less, int *less_height,
+                                 node_t **equal, node_t **greater, int *greater_height){
+  node_t *rest;
+  int rest_height;
+  rbtree_split_node(t, node, height, key, false, less, less_height, &rest, &rest_height);
+  *equal = NULL;
+  node_t *first = rest;
+  while (first != t->nil && first->left != t->nil){
+    first = first->left;
+  }
+  if (first == t->nil || key < first->key){
+    *greater = rest;
+    *greater_height = rest_height;
+    return 0;
+  }
+  node_t *range;
+  int range_height;
+  rbtree_split_node(t, rest, rest_height, key, true, &range, &range_height, greater, greater_height);
+  rbtree_to_list(t, range, equal);
+  size_t count = 0;
+  for (node_t *p = *equal; p != NULL; p = p->right){
+    count += rbtree_node_count(p);
+  }
+  return count;
+}
 
-  // 부모 노드가 루트 노드였다면
-  if (parent_node == t->root){
-    // 루트 노드를 노드로 한다.
-    t->root = node;
-  } else {
-    // 조부모의 노드의 왼쪽에 부모 노드라면 그 자리를 노드로 넣기 위해 if 문 사용
-    if (grand_parent_node->left == parent_node){
-      grand_parent_node->left = node;
-    } else {
-      grand_parent_node->right = node;
-    }
+// 두 서브트리의 노드를 모두 모아 한 서브트리로 만든다. (같은 key는 양쪽 노드가 모두 남음)
+// b의 루트 key로 a를 나누고 양쪽을 재귀로 합친 뒤 b의 루트로 이어 붙인다.
+// RBTREE_COUNTED에서는 a의 같은 key 노드를 떼어내서 b의 루트 count에 더하고 반환한다.
+static node_t *rbtree_union_nodes(rbtree *t, node_t *a, const int a_height, node_t *b, const int b_height, int *height){
+  if (a == t->nil){
+    *height = b_height;
+    return b;
   }
-  // 노드의 부모를 조부모로 바로 연결 (G <-> N 양방향 연결)
-  node->parent = grand_parent_node;
-  // 부모 노드를 노드의 오른쪽 자식으로 설정 하기 (P <-> N 양방향 연결)
-  parent_node->parent = node;
-  node->right = parent_node;
-  right_node->parent = parent_node;                                     
-  // 노드의 원래의 오른쪽 자식은 부모의 왼쪽 자식으로 설정해야함. 
-  parent_node->left = right_node;    
+  if (b == t->nil){
+    *height = a_height;
+    return a;
+  }
+  const int child_height = b_height - (rbtree_color(b) == RBTREE_BLACK);
+  node_t *b_left = b->left;
+  node_t *b_right = b->right;
+  if (b_left != t->nil){
+    rbtree_set_parent(b_left, t->nil);
+  }
+  if (b_right != t->nil){
+    rbtree_set_parent(b_right, t->nil);
+  }
+  node_t *a_less, *a_rest;
+  int less_height, rest_height, left_height, right_height;
+#ifdef RBTREE_COUNTED
+  node_t *a_equal;
+  b->count += rbtree_split_equal(t, a, a_height, b->key, &a_less, &less_height, &a_equal, &a_rest, &rest_height);
+  while (a_equal != NULL){
+    node_t *next = a_equal->right;
+    node_free(t, a_equal);
+    a_equal = next;
+  }
+#elif defined(RBTREE_NO_PARENT)
+  rbtree_split_before(t, a, a_height, b, &a_less, &less_height, &a_rest, &rest_height);
+#else
+  rbtree_split_node(t, a, a_height, b->key, false, &a_less, &less_height, &a_rest, &rest_height);
+#endif
+  node_t *left = rbtree_union_nodes(t, a_less, less_height, b_left, child_height, &left_height);
+  node_t *right = rbtree_union_nodes(t, a_rest, rest_height, b_right, child_height, &right_height);
+  return rbtree_join_nodes(t, left, left_height, b, right, right_height, height);
 }
 
-node_t *rbtree_find(const rbtree *t, const key_t key) {
-  node_t *current_node = t->root;
-  while (current_node != t->nil){
-    if (current_node->key == key){
-      return current_node;
-    } else if (key < current_node->key){
-      current_node = current_node->left;
+// 리스트의 key를 앞에서부터 keep개만 남기고 나머지 노드를 반환한다. 남긴 노드 수를 돌려주고 지운 key 수를 freed에 더한다.
+// RBTREE_COUNTED에서는 경계에 걸린 노드의 count를 줄여서 남긴다.
+static size_t rbtree_trim_list(rbtree *t, node_t *list, size_t keep, size_t *freed){
+  size_t nodes = 0;
+  while (list != NULL){
+    node_t *next = list->right;
+    const size_t copies = rbtree_node_count(list);
+    if (keep == 0){
+      node_free(t, list);
+      *freed += copies;
     } else {
-      current_node = current_node->right;
+      const size_t kept = copies < keep ? copies : keep;
+#ifdef RBTREE_COUNTED
+      list->count = kept;
+#endif
+      *freed += copies - kept;
+      keep -= kept;
+      nodes++;
     }
+    list = next;
   }
-  return NULL;
+  return nodes;
 }
 
-node_t *rbtree_min(const rbtree *t) {
-  // 현재 노드를 루트 노드로 설정
-  node_t *current_node = t->root;
-  // 왼쪽 끝까지 노드를 확인
-  while (current_node->left != t->nil){
-    current_node = current_node->left;
+// a의 노드 중 key별로 정해진 개수만 남긴다. intersect면 min(a의 개수, b의 개수), 아니면 a의 개수 - b의 개수 (0 이상)
+// b의 노드와 남기지 않는 a의 노드는 반환하고 지운 key 수를 freed에 더한다.
+// b의 루트 key로 a를 나누고 양쪽을 재귀로 처리한 뒤, 남긴 같은 key의 노드 하나를 가운데로 이어 붙인다.
+static node_t *rbtree_filter_nodes(rbtree *t, node_t *a, const int a_height, node_t *b, const int b_height,
+                                   const bool intersect, size_t *freed, int *height){
+  if (a == t->nil || b == t->nil){
+    *freed += rbtree_free_subtree(t, b, NULL, NULL);
+    if (intersect){
+      *freed += rbtree_free_subtree(t, a, NULL, NULL);
+      *height = 0;
+      return t->nil;
+    }
+    *height = a_height;
+    return a;
+  }
+  const key_t key = b->key;
+  const int child_height = b_height - (rbtree_color(b) == RBTREE_BLACK);
+  node_t *b_less = b->left;
+  node_t *b_greater = b->right;
+  int b_less_height = child_height, b_greater_height = child_height;
+  if (b_less != t->nil){
+    rbtree_set_parent(b_less, t->nil);
+  }
+  if (b_greater != t->nil){
+    rbtree_set_parent(b_greater, t->nil);
+  }
+  // b의 루트와 같은 key는 양쪽 서브트리의 가장자리에만 있을 수 있으므로 있을 때만 떼어낸다.
+  b->right = NULL;
+  size_t b_count = rbtree_node_count(b);
+  node_t *edge = b_less;
+  while (edge != t->nil && edge->right != t->nil){
+    edge = edge->right;
+  }
+  if (edge != t->nil && edge->key == key){
+    node_t *equal, *none;
+    int none_height;
+    b_count += rbtree_split_equal(t, b_less, child_height, key, &b_less, &b_less_height, &equal, &none, &none_height);
+    rbtree_trim_list(t, equal, 0, freed);
+  }
+  edge = b_greater;
+  while (edge != t->nil && edge->left != t->nil){
+    edge = edge->left;
+  }
+  if (edge != t->nil && edge->key == key){
+    node_t *equal, *none;
+    int none_height;
+    b_count += rbtree_split_equal(t, b_greater, child_height, key, &none, &none_height, &equal, &b_greater, &b_greater_height);
+    rbtree_trim_list(t, equal, 0, freed);
   }
-  return current_node;
+  rbtree_trim_list(t, b, 0, freed);
+
+  node_t *a_less, *a_equal, *a_greater;
+  int a_less_height, a_greater_height;
+  const size_t a_count = rbtree_split_equal(t, a, a_height, key, &a_less, &a_less_height, &a_equal, &a_greater, &a_greater_height);
+  size_t keep;
+  if (intersect){
+    keep = a_count < b_count ? a_count : b_count;
+  } else {
+    keep = a_count > b_count ? a_count - b_count : 0;
+  }
+  const size_t kept = rbtree_trim_list(t, a_equal, keep, freed);
+
+  int left_height, right_height;
+  node_t *left = rbtree_filter_nodes(t, a_less, a_less_height, b_less, b_less_height, intersect, freed, &left_height);
+  node_t *right = rbtree_filter_nodes(t, a_greater, a_greater_height, b_greater, b_greater_height, intersect, freed, &right_height);
+  if (kept == 0){
+    return rbtree_concat_nodes(t, left, left_height, right, right_height, height);
+  }
+  node_t *pivot = a_equal;
+  a_equal = pivot->right;
+  int middle_height;
+  node_t *middle = rbtree_build_subtree(t, &a_equal, kept - 1, &middle_height);
+  right = rbtree_concat_nodes(t, middle, middle_height, right, right_height, &right_height);
+  return rbtree_join_nodes(t, left, left_height, pivot, right, right_height, height);
 }
 
-node_t *rbtree_max(const rbtree *t) {
-  // 현재 노드를 루트 노드로 설정
-  node_t *current_node = t->root;
-  // 오른쪽 끝까지 노드를 확인
-  while (current_node->right != t->nil){
-    current_node = current_node->right;
+typedef enum { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE } set_op_t;
+
+// 두 트리의 크기가 이 배수 안이면 join 대신 리스트로 펴서 한 번에 합친다.
+#define SET_MERGE_RATIO 16
+
+// key 순서 리스트 두 개를 key별로 남길 개수만 남기며 합친다. 남은 리스트와 노드 수를 돌려준다. O(n + m)
+// RBTREE_COUNTED에서는 같은 key의 남은 노드를 하나로 합친다.
+static node_t *rbtree_merge_lists(rbtree *t, node_t *a, node_t *b, const set_op_t op, size_t *count, size_t *freed){
+  node_t head;
+  node_t *tail = &head;
+  *count = 0;
+  while (a != NULL || b != NULL){
+    const key_t key = b == NULL || (a != NULL && a->key <= b->key) ? a->key : b->key;
+    size_t a_count = 0, b_count = 0;
+    for (node_t *p = a; p != NULL && p->key == key; p = p->right){
+      a_count += rbtree_node_count(p);
+    }
+    for (node_t *p = b; p != NULL && p->key == key; p = p->right){
+      b_count += rbtree_node_count(p);
+    }
+    size_t a_keep = a_count, b_keep = b_count;
+    if (op == SET_INTERSECTION){
+      a_keep = a_count < b_count ? a_count : b_count;
+      b_keep = 0;
+    } else if (op == SET_DIFFERENCE){
+      a_keep = a_count > b_count ? a_count - b_count : 0;
+      b_keep = 0;
+    }
+    for (int side = 0; side < 2; side++){
+      node_t **run = side == 0 ? &a : &b;
+      size_t keep = side == 0 ? a_keep : b_keep;
+      while (*run != NULL && (*run)->key == key){
+        node_t *node = *run;
+        *run = node->right;
+        const size_t copies = rbtree_node_count(node);
+        const size_t kept = copies < keep ? copies : keep;
+        keep -= kept;
+        *freed += copies - kept;
+        if (kept == 0){
+          node_free(t, node);
+          continue;
+        }
+#ifdef RBTREE_COUNTED
+        node->count = kept;
+        if (tail != &head && tail->key == key){
+          tail->count += kept;
+          node_free(t, node);
+          continue;
+        }
+#endif
+        tail->right = node;
+        tail = node;
+        (*count)++;
+      }
+    }
   }
-  return current_node;
+  tail->right = NULL;
+  return head.right;
 }
 
-int rbtree_erase(rbtree *t, node_t *check_node) {
-  node_t *successor_node; // 삭제할 노드의 대신 들어갈 노드 (이 노드는 삭제될 것임.)
-  node_t *replace_node; // 삭제할 노드에 후보자 노드가 들어가면 원래의 후보자 노드의 오른쪽 트리들을 재설정해줘야함.
-  node_t *parent_successor_node;
-
-  // Step 1) check_node 삭제 후 대체할 successor 노드 찾기
-  // 만약 삭제할 노드의 자식이 2개 이상일때 (왼쪽과 오른쪽 노드가 닐 노드가 아닐때)
-  if (check_node->left != t->nil && check_node->right != t->nil){
-    // 후보 노드는 삭제할 노드의 오른쪽 트리의 가장 작은 값 (오른쪽 노드가 확실히 있기 때문에 확인)
-    successor_node = rbtree_successor_find(t,check_node->right);
-    replace_node = successor_node->right;
-    check_node->key = successor_node->key;
-  }else{ // 자식이 없거나 하나일 경우
-    successor_node = check_node;
-    if (check_node->right != t->nil){
-      replace_node = successor_node->right;
-    } else{
-      replace_node = successor_node->left;
-    }
-  }
-  // 후보자의 부모의 왼쪽에 replace 노드를 양방향 연결 해야 하기 때문에 지정
-  parent_successor_node = successor_node->parent;
-
-  // Step 2) seccessor 노드 제거하기
-  if (successor_node == t->root){
-    t->root = replace_node;
-    t->root->color = RBTREE_BLACK;
-    free(successor_node);
-    return 0;
+// union/intersection/difference의 공통 부분. b의 노드를 a의 pool로 옮긴 뒤 두 트리를 합친다.
+// 한쪽이 훨씬 작으면 작은 쪽 노드마다 큰 쪽을 나누고 붙이는 join 기반으로 O(m log(n/m + 1)),
+// 크기가 비슷하면 그 비용이 선형 병합보다 커지므로 양쪽을 리스트로 펴서 합치고 한 번에 다시 만든다. O(n + m)
+static rbtree *rbtree_set_operation(rbtree *a, rbtree *b, const set_op_t op){
+#ifdef RBTREE_NO_PARENT
+  if (op == SET_UNION && a->size + b->size > RBTREE_SIZE_MAX){
+    return NULL;
   }
+#endif
+  if (a->pool.node_size != b->pool.node_size || rbtree_pool_merge(a, b) != 0){
+    return NULL;
+  }
+  size_t freed = 0;
+  const size_t small = a->size < b->size ? a->size : b->size;
+  const size_t large = a->size < b->size ? b->size : a->size;
+  if (small > 0 && large / small < SET_MERGE_RATIO){
+    node_t *a_list = NULL, *b_list = NULL;
+    size_t count;
+    rbtree_to_list(a, a->root, &a_list);
+    rbtree_to_list(a, b->root, &b_list);
+    node_t *list = rbtree_merge_lists(a, a_list, b_list, op, &count, &freed);
+    rbtree_rebuild_from_list(a, list, count);
+  } else {
+    int height;
+    const int a_height = rbtree_black_height(a, a->root);
+    const int b_height = rbtree_black_height(a, b->root);
+    if (op == SET_UNION){
+#ifdef RBTREE_NO_PARENT
+      // b의 노드에 a의 어떤 seq보다도 큰 seq를 새로 매겨서 (key, seq)가 겹치지 않게 한다. 같은 key는 a의 노드가 먼저
+      // union은 어차피 b의 노드를 모두 거치므로 O(m)을 더해도 비용은 그대로다.
+      if (a->next_seq > RBTREE_SEQ_MAX - b->size){
+        rbtree_renumber_all(a);
+      }
+      rbtree_renumber_subtree(a, b->root);
+#endif
+      rbtree_set_root(a, rbtree_union_nodes(a, a->root, a_height, b->root, b_height, &height));
+    } else {
+      rbtree_set_root(a, rbtree_filter_nodes(a, a->root, a_height, b->root, b_height, op == SET_INTERSECTION, &freed, &height));
+    }
+    a->size = a->size + b->size - freed;
+    rbtree_reset_extremes(a);
+  }
+  free(b);
+  return a;
+}
 
-  // Step 2-1) seccessor 부모와 seccessor 자식 이어주기
-  bool is_successor_black = successor_node->color;
-  bool is_successor_left = parent_successor_node->left == successor_node;
+// a에 b의 key를 모두 더한다. (multiset: 같은 key는 양쪽 개수의 합만큼 남음)
+// 결과는 a이고 b는 해제된다. 노드 크기가 다르거나 메모리가 부족하면 NULL (둘 다 그대로)
+rbtree *rbtree_union(rbtree *a, rbtree *b){
+  return rbtree_set_operation(a, b, SET_UNION);
+}
 
-  // Step 2-1-1) 자식연결
-  if (is_successor_left){
-    parent_successor_node->left = replace_node;
-  } else{
-    parent_successor_node->right = replace_node;
-  }
+// a에 b에도 있는 key만 남긴다. 같은 key는 양쪽 중 적은 개수만큼 남는다.
+rbtree *rbtree_intersection(rbtree *a, rbtree *b){
+  return rbtree_set_operation(a, b, SET_INTERSECTION);
+}
 
-  // Step 2-1-2) 부모도 연결
-  replace_node->parent = parent_successor_node;
-  free(successor_node);
+// a에서 b의 key를 뺀다. 같은 key는 b에 있는 개수만큼 지운다.
+rbtree *rbtree_difference(rbtree *a, rbtree *b){
+  return rbtree_set_operation(a, b, SET_DIFFERENCE);
+}
 
-  // Step 3) 불균형 복구 함수 호출
-  if (is_successor_black){
-    rbtree_erase_fixup(t,parent_successor_node,is_successor_left);
+static node_t *rbtree_copy_nodes(rbtree *dst, const rbtree *src, const node_t *node, node_t *parent){
+  if (node == src->nil){
+    return dst->nil;
+  }
+  node_t *copy = node_alloc(dst);
+  if (copy == NULL){
+    return NULL;
   }
+  // rbmap처럼 노드 뒤에 붙은 key/value도 같이 복사한다.
+  memcpy(copy, node, src->pool.node_size);
+  rbtree_set_parent(copy, parent);
+  copy->left = rbtree_copy_nodes(dst, src, node->left, copy);
+  copy->right = copy->left == NULL ? NULL : rbtree_copy_nodes(dst, src, node->right, copy);
+  return copy->right == NULL ? NULL : copy;
+}
 
-  return 0;
+// 같은 모양의 트리를 새로 만든다. 집합 연산은 입력을 바꾸므로 원본을 남기려면 복사본을 넘긴다. 실패하면 NULL
+rbtree *rbtree_copy(const rbtree *t){
+  rbtree *copy = new_rbtree();
+  if (copy == NULL){
+    return NULL;
+  }
+  copy->pool.node_size = t->pool.node_size;
+  copy->root = rbtree_copy_nodes(copy, t, t->root, copy->nil);
+  if (copy->root == NULL){
+    delete_rbtree(copy);
+    return NULL;
+  }
+  copy->size = t->size;
+#ifdef RBTREE_NO_PARENT
+  copy->next_seq = t->next_seq;
+#endif
+  rbtree_reset_extremes(copy);
+  return copy;
 }
 
+#ifndef RBTREE_NO_PARENT
 void rbtree_erase_fixup(rbtree *t, node_t *parent_node, bool is_node_left){
+  RBTREE_STAT_ADD(t, erase_fixup_calls, 1);
+  RBTREE_STAT_DEPTH(t, erase_fixup_depth_max);
   // 검은색이 추가된 부분의 노드를 찾음
   node_t *extra_black = is_node_left ? parent_node->left:parent_node->right;
 
   // 검은색이 추가된 노드의 색이 빨간색이면 그냥 검은색으로 바꿔주고 끝냄.
-  if (extra_black->color == RBTREE_RED){
-    extra_black->color = RBTREE_BLACK;
+  if (rbtree_color(extra_black) == RBTREE_RED){
+    rbtree_set_color(extra_black, RBTREE_BLACK);
     return;
   }
 
@@ -318,7 +2411,8 @@ void rbtree_erase_fixup(rbtree *t, node_t *parent_node, bool is_node_left){
   node_t *sibling_right_node = sibling_node->right;
 
   // Case 1) 형재의 색이 RED라면
-  if (sibling_node->color == RBTREE_RED){
+  if (rbtree_color(sibling_node) == RBTREE_RED){
+    RBTREE_STAT_ADD(t, erase_fixup_cases[0], 1);
     if (is_node_left){
       rotate_L(t,sibling_node);
     }else{
@@ -336,7 +2430,8 @@ void rbtree_erase_fixup(rbtree *t, node_t *parent_node, bool is_node_left){
   // Case 3,4 는 가까이 있는가, 멀리 있는가를 확인한다. 멀리 있는 노드가 빨간색이면 케이스 4 아니면 케이스 3임.
 
   // Case 3) 노드가 왼쪽 일때, 멀리 있는 노드의 색이 검정이고 가까이 있는 노드의 색이 빨강일 때
-  if (is_node_left && near->color==RBTREE_RED && distant->color==RBTREE_BLACK){
+  if (is_node_left && rbtree_color(near)==RBTREE_RED && rbtree_color(distant)==RBTREE_BLACK){
+    RBTREE_STAT_ADD(t, erase_fixup_cases[2], 1);
     rotate_R(t,near);
     exchange_color(sibling_node,near);
     rbtree_erase_fixup(t,parent_node,is_node_left);
@@ -344,15 +2439,17 @@ void rbtree_erase_fixup(rbtree *t, node_t *parent_node, bool is_node_left){
   }
 
   // Case 4) 노드가 왼쪽 일 때, 멀리 있는 노드의 색이 빨간색일때
-  if (is_node_left && distant->color==RBTREE_RED){
+  if (is_node_left && rbtree_color(distant)==RBTREE_RED){
+    RBTREE_STAT_ADD(t, erase_fixup_cases[3], 1);
     rotate_L(t,sibling_node);
     exchange_color(sibling_node,parent_node);
-    distant->color = RBTREE_BLACK;
+    rbtree_set_color(distant, RBTREE_BLACK);
     return;
   }
 
   // Case 3) 노드가 오른쪽일 때, 멀리 있는 노드의 색이 검정이고 가까이 있는 노드의 색이 빨강일때
-  if (near->color==RBTREE_RED && distant->color==RBTREE_BLACK){
+  if (rbtree_color(near)==RBTREE_RED && rbtree_color(distant)==RBTREE_BLACK){
+    RBTREE_STAT_ADD(t, erase_fixup_cases[2], 1);
     rotate_L(t,near);
     exchange_color(sibling_node, near);
     rbtree_erase_fixup(t,parent_node,is_node_left);
@@ -360,30 +2457,33 @@ void rbtree_erase_fixup(rbtree *t, node_t *parent_node, bool is_node_left){
   }
 
   // Case 4) 노드가 오른쪽일 때
-  if (distant->color==RBTREE_RED){
+  if (rbtree_color(distant)==RBTREE_RED){
+    RBTREE_STAT_ADD(t, erase_fixup_cases[3], 1);
     rotate_R(t,sibling_node);
     exchange_color(sibling_node,parent_node);
-    distant->color=RBTREE_BLACK;
+    rbtree_set_color(distant, RBTREE_BLACK);
     return;
   }
 
   // Case 2) 형재의 노드가 검정색이고 자식들도 모두 검정색이면 형재의 색을 빨강으로 바꾸고
-  sibling_node->color = RBTREE_RED;
+  RBTREE_STAT_ADD(t, erase_fixup_cases[1], 1);
+  rbtree_set_color(sibling_node, RBTREE_RED);
 
   // 부모가 왼쪽인지 확인한다음
-  bool is_parent_left = parent_node->parent->left == parent_node;
+  bool is_parent_left = rbtree_parent(parent_node)->left == parent_node;
 
   // 부모가 root 노드가 아니라면 재귀로 올라감 (부모가 extra 노드가 되니까.)
   if (parent_node != t->root){
-    rbtree_erase_fixup(t,parent_node->parent, is_parent_left);
+    rbtree_erase_fixup(t,rbtree_parent(parent_node), is_parent_left);
   }
 }
+#endif
 
 // node1 과 node2의 색을 바꾼다.
 void exchange_color(node_t *node1, node_t *node2){
-  int tmp_color = node1->color;
-  node1->color = node2->color;
-  node2->color = (tmp_color == RBTREE_BLACK) ? RBTREE_BLACK:RBTREE_RED;
+  int tmp_color = rbtree_color(node1);
+  rbtree_set_color(node1, rbtree_color(node2));
+  rbtree_set_color(node2, (tmp_color == RBTREE_BLACK) ? RBTREE_BLACK:RBTREE_RED);
 }
 
 // 삭제할 노드를 대체할 후보 노드를 찾는다. (오른쪽 트리에서 가장 작은 값)
@@ -394,13 +2494,187 @@ node_t *rbtree_successor_find(const rbtree *t, node_t *node) {
   return node;
 }
 
-// 트리에 있는 값들을 오름차 순으로 정렬해서 arr 배열에 넣는다.
+#ifdef RBTREE_NO_PARENT
+// 부모 포인터가 없으므로 트리에 남겨 둔 경로(finger)로 올라가고, 돌려준 노드까지의 경로를 다시 남긴다.
+// 그래서 처음부터 끝까지 순회하면 노드당 평균 O(1)이고, 경로가 node에서 끝나지 않을 때만 O(log n)에 다시 찾는다.
+node_t *rbtree_next(rbtree *t, const node_t *node){
+  return rbtree_path_next(t, rbtree_finger_at(t, node));
+}
+
+node_t *rbtree_prev(rbtree *t, const node_t *node){
+  return rbtree_path_prev(t, rbtree_finger_at(t, node));
+}
+#else
+// 중위순회 기준 다음 노드를 반환한다. 마지막 노드면 NULL
+// 부모 포인터를 따라가므로 처음부터 끝까지 순회하면 노드당 평균 O(1)
+node_t *rbtree_next(const rbtree *t, const node_t *node){
+  // 오른쪽 서브트리가 있으면 그 중 가장 작은 노드
+  if (node->right != t->nil){
+    return rbtree_successor_find(t, node->right);
+  }
+  // 없으면 왼쪽 자식으로 올라오게 되는 첫 조상
+  node_t *parent = rbtree_parent(node);
+  while (parent != t->nil && node == parent->right){
+    node = parent;
+    parent = rbtree_parent(parent);
+  }
+  return parent != t->nil ? parent : NULL;
+}
+
+// 중위순회 기준 이전 노드를 반환한다. 첫 노드면 NULL
+node_t *rbtree_prev(const rbtree *t, const node_t *node){
+  // 왼쪽 서브트리가 있으면 그 중 가장 큰 노드
+  if (node->left != t->nil){
+    node_t *current_node = node->left;
+    while (current_node->right != t->nil){
+      current_node = current_node->right;
+    }
+    return current_node;
+  }
+  // 없으면 오른쪽 자식으로 올라오게 되는 첫 조상
+  node_t *parent = rbtree_parent(node);
+  while (parent != t->nil && node == parent->left){
+    node = parent;
+    parent = rbtree_parent(parent);
+  }
+  return parent != t->nil ? parent : NULL;
+}
+#endif
+
+// key 이상인 첫 노드 (없으면 NULL). 같은 key가 여러 개면 가장 앞의 노드
+node_t *rbtree_lower_bound(const rbtree *t, const key_t key){
+  node_t *result = NULL;
+  node_t *current_node = t->root;
+  while (current_node != t->nil){
+    if (current_node->key < key){
+      current_node = current_node->right;
+    } else {
+      // 후보로 기억하고 더 앞쪽이 있는지 왼쪽 탐색
+      result = current_node;
+      current_node = current_node->left;
+    }
+  }
+  return result;
+}
+
+// key보다 큰 첫 노드 (없으면 NULL)
+node_t *rbtree_upper_bound(const rbtree *t, const key_t key){
+  node_t *result = NULL;
+  node_t *current_node = t->root;
+  while (current_node != t->nil){
+    if (key < current_node->key){
+      result = current_node;
+      current_node = current_node->left;
+    } else {
+      current_node = current_node->right;
+    }
+  }
+  return result;
+}
+
+// key 이하인 마지막 노드 (없으면 NULL). 같은 key가 여러 개면 가장 뒤의 노드
+node_t *rbtree_floor(const rbtree *t, const key_t key){
+  node_t *result = NULL;
+  node_t *current_node = t->root;
+  while (current_node != t->nil){
+    if (key < current_node->key){
+      current_node = current_node->left;
+    } else {
+      result = current_node;
+      current_node = current_node->right;
+    }
+  }
+  return result;
+}
+
+// key 이상인 첫 노드 (lower_bound와 같음)
+node_t *rbtree_ceil(const rbtree *t, const key_t key){
+  return rbtree_lower_bound(t, key);
+}
+
+// key와 같은 노드들의 범위 [*first, *end)를 구한다. rbtree_next로 *first부터 *end 전까지 순회
+// 같은 key가 없으면 *first == *end, *end가 NULL이면 트리 끝까지
+void rbtree_equal_range(const rbtree *t, const key_t key, node_t **first, node_t **end){
+  *first = rbtree_lower_bound(t, key);
+  *end = rbtree_upper_bound(t, key);
+}
+
+// 트리에 있는 값들을 오름차 순으로 정렬해서 arr 배열에 최대 n개까지 넣는다. 넣은 개수를 반환
 int rbtree_to_array(const rbtree *t, key_t *arr, const size_t n) {
-  node_t *node = t->root;
-  int idx=0;
-  rbtree_inOrder(t,arr,node, &idx);
+  rbtree_cursor cursor = {0};
+  return (int)rbtree_to_array_page(t, arr, n, &cursor);
+}
 
-  return 0;
+// 페이지 안에서 다음 노드로 옮겨 간다. 부모 포인터가 없으면 시작 노드까지의 경로를 들고 다니며 그 경로로 올라간다.
+#ifdef RBTREE_NO_PARENT
+#define RBTREE_PAGE_NEXT(t, node) rbtree_path_next(t, &path)
+#else
+#define RBTREE_PAGE_NEXT(t, node) rbtree_next(t, node)
+#endif
+
+// cursor 위치부터 최대 n개의 key를 순서대로 arr에 넣고 cursor를 다음 페이지 위치로 옮긴다.
+// 넣은 개수를 반환한다. 페이지 사이에 삽입/삭제가 있어도 cursor는 key로 위치를 다시 찾으므로
+// 시작 위치를 찾는 데 O(log n), 나머지는 페이지 크기에 비례한다.
+size_t rbtree_to_array_page(const rbtree *t, key_t *arr, const size_t n, rbtree_cursor *cursor) {
+  if (cursor->done || t->root == t->nil){
+    cursor->done = true;
+    return 0;
+  }
+
+  // 시작 노드 찾기: 처음이면 최소 노드, 아니면 cursor key 이상인 첫 노드에서 이미 내보낸 중복 key를 건너뛴다.
+  // RBTREE_COUNTED에서는 노드 하나가 같은 key 여러 개이므로 used로 노드 안에서의 위치를 같이 센다.
+  node_t *node;
+  size_t run = 0;   // 마지막으로 내보낸 key와 같은 key를 연속해서 내보낸 개수
+  size_t used = 0;  // node의 key 중 이미 내보낸 개수
+  if (!cursor->started){
+    node = rbtree_min(t);
+  } else {
+    node = rbtree_lower_bound(t, cursor->key);
+  }
+#ifdef RBTREE_NO_PARENT
+  rbtree_path path;
+  if (node != NULL){
+    rbtree_path_locate(t, node, &path);
+  }
+#endif
+  if (cursor->started){
+    while (node != NULL && node->key == cursor->key && run < cursor->skip){
+      const size_t copies = rbtree_node_count(node);
+      const size_t step = copies < cursor->skip - run ? copies : cursor->skip - run;
+      run += step;
+      used = step;
+      if (used == copies){
+        node = RBTREE_PAGE_NEXT(t, node);
+        used = 0;
+      }
+    }
+  }
+  key_t last_key = cursor->key;
+
+  size_t idx = 0;
+  while (node != NULL && idx < n){
+    if (idx > 0 || cursor->started){
+      run = node->key == last_key ? run + 1 : 1;
+    } else {
+      run = 1;
+    }
+    last_key = node->key;
+    arr[idx++] = node->key;
+    if (++used == rbtree_node_count(node)){
+      node = RBTREE_PAGE_NEXT(t, node);
+      used = 0;
+    }
+  }
+
+  cursor->started = true;
+  if (node == NULL){
+    cursor->done = true;
+    return idx;
+  }
+  // 다음 페이지는 node에서 시작. node가 방금 내보낸 key와 같다면 그만큼 건너뛰어야 한다.
+  cursor->key = node->key;
+  cursor->skip = node->key == last_key ? run : 0;
+  return idx;
 }
 
 // 중위순회로 재귀를 사용해서 순차적으로 arr에 입력
@@ -408,9 +2682,78 @@ void rbtree_inOrder(const rbtree *t, key_t *arr, node_t *node, int *idx){
   if(node->left != t->nil){
     rbtree_inOrder(t,arr,node->left,idx);
   }
+  for (size_t i = 0; i < rbtree_node_count(node); i++){
     arr[*idx] = node->key;
     (*idx)++;
+  }
   if(node->right !=t->nil){
     rbtree_inOrder(t,arr,node->right,idx);
   }
-}
\ No newline at end of file
+}
+#ifdef RBTREE_ORDER_STATS
+// k번째(0부터) 작은 key를 가진 노드를 반환한다. k가 key 수 이상이면 NULL
+node_t *rbtree_select(const rbtree *t, size_t k){
+  node_t *node = t->root;
+  while (node != t->nil){
+    size_t left_size = node->left->size;
+    if (k < left_size){
+      node = node->left;
+    } else if (k < left_size + rbtree_node_count(node)){
+      return node;
+    } else {
+      // 왼쪽 서브트리와 현재 노드를 건너뛴다.
+      k -= left_size + rbtree_node_count(node);
+      node = node->right;
+    }
+  }
+  return NULL;
+}
+
+// key보다 작은 key의 개수를 반환한다. (정렬했을 때 key가 들어갈 첫 위치)
+size_t rbtree_rank(const rbtree *t, const key_t key){
+  size_t rank = 0;
+  node_t *node = t->root;
+  while (node != t->nil){
+    if (node->key < key){
+      rank += node->left->size + rbtree_node_count(node);
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  return rank;
+}
+
+// key 이하인 key의 개수를 반환한다.
+static size_t rbtree_rank_upper(const rbtree *t, const key_t key){
+  size_t rank = 0;
+  node_t *node = t->root;
+  while (node != t->nil){
+    if (node->key <= key){
+      rank += node->left->size + rbtree_node_count(node);
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  return rank;
+}
+
+// [lo, hi] 범위에 있는 key의 개수를 반환한다.
+size_t rbtree_count_range(const rbtree *t, const key_t lo, const key_t hi){
+  if (hi < lo){
+    return 0;
+  }
+  return rbtree_rank_upper(t, hi) - rbtree_rank(t, lo);
+}
+#endif
+
+#ifdef RBTREE_STATS
+rbtree_stats rbtree_get_stats(const rbtree *t){
+  return t->stats;
+}
+
+void rbtree_reset_stats(rbtree *t){
+  memset(&t->stats, 0, sizeof(t->stats));
+}
+#endif
@@ -3,40 +3,231 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum { RBTREE_RED, RBTREE_BLACK } color_t;
 
 typedef int key_t;
 
+#if defined(RBTREE_NO_PARENT) && defined(RBTREE_PACKED_COLOR)
+#error "RBTREE_NO_PARENT에는 color를 숨길 부모 포인터가 없으므로 RBTREE_PACKED_COLOR와 같이 쓸 수 없다"
+#endif
+
 typedef struct node_t {
+#if defined(RBTREE_NO_PARENT)
+  // 부모 포인터 없이 자식만 둔다. 부모가 필요한 연산은 루트부터 내려온 경로를 대신 쓴다. (64bit에서 32 -> 24byte)
+  // color는 1bit면 되므로 남는 31bit에 같은 key끼리의 순서(seq)를 둔다. 노드 포인터만으로 경로를 찾을 때 쓴다.
+  unsigned int color : 1;
+  unsigned int seq : 31;
+  key_t key;
+  struct node_t *left, *right;
+#elif defined(RBTREE_PACKED_COLOR)
+  // 노드는 최소 4byte 정렬이므로 부모 포인터의 최하위 bit에 color를 같이 저장
+  uintptr_t parent_color;
+  struct node_t *left, *right;
+  key_t key;
+#else
   color_t color;
   key_t key;
   struct node_t *parent, *left, *right;
+#endif
+#ifdef RBTREE_ORDER_STATS
+  unsigned int size;  // 이 노드를 루트로 하는 서브트리의 key 수 (nil은 0)
+#endif
+#ifdef RBTREE_COUNTED
+  unsigned int count;  // 이 노드의 key가 들어간 횟수
+#endif
 } node_t;
 
+// color와 parent는 layout에 따라 저장 방식이 달라지므로 항상 이 함수들로 접근한다.
+#ifdef RBTREE_PACKED_COLOR
+static inline color_t rbtree_color(const node_t *node) {
+  return (color_t)(node->parent_color & 1);
+}
+static inline node_t *rbtree_parent(const node_t *node) {
+  return (node_t *)(node->parent_color & ~(uintptr_t)1);
+}
+static inline void rbtree_set_color(node_t *node, const color_t color) {
+  node->parent_color = (node->parent_color & ~(uintptr_t)1) | (uintptr_t)color;
+}
+static inline void rbtree_set_parent(node_t *node, node_t *parent) {
+  node->parent_color = (uintptr_t)parent | (node->parent_color & 1);
+}
+#elif defined(RBTREE_NO_PARENT)
+// 부모를 저장하지 않으므로 rbtree_parent는 없고 rbtree_set_parent는 아무것도 하지 않는다.
+static inline color_t rbtree_color(const node_t *node) { return node->color; }
+static inline void rbtree_set_color(node_t *node, const color_t color) { node->color = color; }
+static inline void rbtree_set_parent(node_t *node, node_t *parent) { (void)node; (void)parent; }
+#else
+static inline color_t rbtree_color(const node_t *node) { return node->color; }
+static inline node_t *rbtree_parent(const node_t *node) { return node->parent; }
+static inline void rbtree_set_color(node_t *node, const color_t color) { node->color = color; }
+static inline void rbtree_set_parent(node_t *node, node_t *parent) { node->parent = parent; }
+#endif
+
+// 노드 하나가 나타내는 key 수. RBTREE_COUNTED에서는 같은 key를 새 노드 대신 count로 세고, 아니면 항상 1
+#ifdef RBTREE_COUNTED
+static inline size_t rbtree_node_count(const node_t *node) { return node->count; }
+#else
+static inline size_t rbtree_node_count(const node_t *node) { (void)node; return 1; }
+#endif
+
+// node pool: 노드를 큰 chunk 단위로 할당하고 삭제된 노드는 free list로 재사용
+typedef struct node_chunk_t {
+  struct node_chunk_t *next;
+  size_t capacity;  // chunk에 들어있는 노드 수
+  node_t nodes[];
+} node_chunk_t;
+
+// split으로 나뉜 트리들이 같이 쓰는 chunk 묶음. 참조하는 트리가 모두 지워지면 해제한다.
+typedef struct node_arena_t {
+  unsigned refs;
+  node_chunk_t *chunks;
+  struct node_arena_t *parents[2];  // 만들 때 넘겨받은 이전 묶음의 참조
+} node_arena_t;
+
+typedef struct {
+  node_chunk_t *chunks;   // 가장 최근에 할당한 chunk가 맨 앞
+  size_t chunk_used;      // 맨 앞 chunk에서 bump 방식으로 사용한 노드 수
+  node_t *free_list;      // 삭제된 노드 목록 (right 포인터로 연결)
+  node_t *free_tail;      // free list의 마지막 노드 (join에서 두 목록을 잇는 데 사용)
+  size_t node_size;       // 노드 하나의 byte 수 (node_t 뒤에 key/value를 붙여 쓰는 경우 더 큼)
+  node_arena_t *arena;    // 다른 트리와 같이 쓰는 chunk (split/join을 한 적이 없으면 NULL)
+} node_pool_t;
+
+// rbtree_to_array_page가 다음 페이지를 이어서 내보낼 위치. {0}으로 초기화하면 처음부터 시작
+typedef struct {
+  bool started;  // false면 가장 작은 key부터
+  bool done;     // 마지막 key까지 내보냈으면 true
+  key_t key;     // 다음 페이지의 첫 key
+  size_t skip;   // key와 같은 값 중 이미 내보낸 개수 (중복 key)
+} rbtree_cursor;
+
+#ifdef RBTREE_NO_PARENT
+// 부모 포인터 대신 쓰는 루트부터의 경로. node[0]이 루트, node[len - 1]이 지금 보고 있는 노드
+// 높이는 2 * log2(n + 1) 이하이므로 주소 공간에 들어가는 어떤 트리도 128을 넘지 않는다.
+#define RBTREE_PATH_MAX 128
+typedef struct {
+  node_t *node[RBTREE_PATH_MAX];
+  int len;
+} rbtree_path;
+
+// seq의 상한. 다 쓰면 트리 전체를 중위순회 순서로 다시 매긴다. (test에서는 작게 잡아서 다시 매기는 경우를 만든다)
+#ifndef RBTREE_SEQ_MAX
+#define RBTREE_SEQ_MAX 0x7fffffffu
+#endif
+// 한 트리에 둘 수 있는 key 수. 다시 매긴 뒤에도 seq가 절반 넘게 남아야 그 O(n)이 그만큼의 삽입에 나뉜다.
+// 이만큼 찬 트리에 넣거나 합치는 연산은 메모리가 부족할 때처럼 실패한다.
+#define RBTREE_SIZE_MAX (RBTREE_SEQ_MAX / 2)
+#endif
+
+#ifdef RBTREE_STATS
+// 연산 횟수 통계. RBTREE_STATS로 build 했을 때만 rbtree에 들어간다.
+typedef struct {
+  uint64_t comparisons;              // rbtree_find, rbtree_insert에서 key와 비교한 노드 수
+  uint64_t rotations_left;           // rotate_L 호출 수
+  uint64_t rotations_right;          // rotate_R 호출 수
+  uint64_t insert_fixup_cases[3];    // [i]: 삽입 case i + 1 (1: 삼촌 RED, 2: 꺾인 모양, 3: 곧은 모양)
+  uint64_t erase_fixup_cases[4];     // [i]: 삭제 case i + 1
+  uint64_t insert_fixup_calls;       // rbtree_insert_fixup 호출 수 (재귀 포함)
+  uint64_t erase_fixup_calls;        // rbtree_erase_fixup 호출 수 (재귀 포함)
+  uint64_t insert_fixup_depth_max;   // 삽입 한 번에 fixup이 재귀한 최대 깊이
+  uint64_t erase_fixup_depth_max;    // 삭제 한 번에 fixup이 재귀한 최대 깊이
+  uint64_t fixup_depth;              // 진행 중인 fixup의 현재 깊이
+  uint64_t nodes_allocated;
+  uint64_t nodes_freed;
+} rbtree_stats;
+#endif
+
 typedef struct {
   node_t *root;
-  node_t *nil;  // for sentinel
+  node_t *nil;  // for sentinel. 모든 트리가 같은 읽기 전용 nil을 쓴다.
+  size_t size;  // 트리에 들어있는 key 수 (RBTREE_COUNTED가 아니면 노드 수와 같음)
+  node_t *leftmost;   // 가장 작은 key의 노드 (비어 있으면 nil)
+  node_t *rightmost;  // 가장 큰 key의 노드 (비어 있으면 nil)
+  node_pool_t pool;
+#ifdef RBTREE_NO_PARENT
+  unsigned int next_seq;  // 다음에 넣는 노드의 seq (트리에 있는 어떤 seq보다도 큼)
+  // 마지막으로 넣었거나 rbtree_next/rbtree_prev로 돌려준 노드까지의 경로 (len이 0이면 없음)
+  // 같은 노드에서 이어지는 순회와 삽입은 루트부터 다시 내려가지 않고 이 경로를 쓴다. 모양이 바뀌면 버린다.
+  rbtree_path finger;
+#endif
+#ifdef RBTREE_STATS
+  rbtree_stats stats;
+#endif
 } rbtree;
 
 void exchange_color(node_t *, node_t *);
+#ifndef RBTREE_NO_PARENT
+// 부모 포인터를 따라 올라가는 fixup과 회전 (RBTREE_NO_PARENT에서는 rbtree.c 안의 경로 버전만 있음)
 void rbtree_erase_fixup(rbtree *, node_t *, bool);
+void rbtree_insert_fixup(rbtree *, node_t *);
+void rotate_R(rbtree *, node_t *);
+void rotate_L(rbtree *, node_t *);
+#endif
 node_t *rbtree_successor_find(const rbtree *, node_t *);
 void rbtree_inOrder(const rbtree *,key_t *, node_t *, int *);
 void tree_delete_traverse(rbtree *, node_t *);
-void rotate_R(rbtree *, node_t *);
-void rotate_L(rbtree *, node_t *);
+node_t *node_alloc(rbtree *);
+void node_free(rbtree *, node_t *);
+
+node_t *rbtree_build_from_list(rbtree *, node_t **, size_t, node_t *, int, int);
+void rbtree_to_list(const rbtree *, node_t *, node_t **);
+void rbtree_rebuild_from_list(rbtree *, node_t *, size_t);
 
 rbtree *new_rbtree(void);
+rbtree *rbtree_from_sorted_array(const key_t *, const size_t);
 void delete_rbtree(rbtree *);
+size_t rbtree_shrink(rbtree *);
 
 node_t *rbtree_insert(rbtree *, const key_t);
+node_t *rbtree_insert_unique(rbtree *, const key_t);
+node_t *rbtree_insert_hint(rbtree *, node_t *, const key_t);
+size_t rbtree_insert_batch(rbtree *, const key_t *, const size_t);
 node_t *rbtree_find(const rbtree *, const key_t);
+size_t rbtree_find_batch(const rbtree *, const key_t *, const size_t, node_t **);
 node_t *rbtree_min(const rbtree *);
 node_t *rbtree_max(const rbtree *);
 int rbtree_erase(rbtree *, node_t *);
+bool rbtree_pop_min(rbtree *, key_t *);
+bool rbtree_pop_max(rbtree *, key_t *);
+node_t *rbtree_update_key(rbtree *, node_t *, const key_t);
+size_t rbtree_erase_range(rbtree *, const key_t, const key_t);
+size_t rbtree_erase_range_fn(rbtree *, const key_t, const key_t, void (*)(key_t, void *), void *);
+rbtree *rbtree_join(rbtree *, rbtree *);
+rbtree *rbtree_join_key(rbtree *, const key_t, rbtree *);
+rbtree *rbtree_union(rbtree *, rbtree *);
+rbtree *rbtree_intersection(rbtree *, rbtree *);
+rbtree *rbtree_difference(rbtree *, rbtree *);
+rbtree *rbtree_copy(const rbtree *);
+
+#ifdef RBTREE_NO_PARENT
+// 부모 포인터가 없으면 옮겨 간 자리를 트리의 finger에 남기므로 트리를 바꾼다. (같은 트리를 여러 thread가 동시에 돌 수 없음)
+node_t *rbtree_next(rbtree *, const node_t *);
+node_t *rbtree_prev(rbtree *, const node_t *);
+#else
+node_t *rbtree_next(const rbtree *, const node_t *);
+node_t *rbtree_prev(const rbtree *, const node_t *);
+#endif
+node_t *rbtree_lower_bound(const rbtree *, const key_t);
+node_t *rbtree_upper_bound(const rbtree *, const key_t);
+node_t *rbtree_floor(const rbtree *, const key_t);
+node_t *rbtree_ceil(const rbtree *, const key_t);
+void rbtree_equal_range(const rbtree *, const key_t, node_t **, node_t **);
 
 int rbtree_to_array(const rbtree *, key_t *, const size_t);
-void rbtree_insert_fixup(rbtree *, node_t *);
+size_t rbtree_to_array_page(const rbtree *, key_t *, const size_t, rbtree_cursor *);
+
+#ifdef RBTREE_ORDER_STATS
+node_t *rbtree_select(const rbtree *, size_t);
+size_t rbtree_rank(const rbtree *, const key_t);
+size_t rbtree_count_range(const rbtree *, const key_t, const key_t);
+// 나뉜 트리의 key 수를 서브트리 크기로 O(1)에 구하므로 이 option에서만 있다. (join은 크기를 더하기만 해서 항상 있음)
+int rbtree_split(rbtree *, const key_t, rbtree **, rbtree **);
+#endif
+#ifdef RBTREE_STATS
+rbtree_stats rbtree_get_stats(const rbtree *);
+void rbtree_reset_stats(rbtree *);
+#endif
 
 #endif  // _RBTREE_H_
@@ -0,0 +1,416 @@
+#ifndef _RBTREE_GEN_H_
+#define _RBTREE_GEN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "rbtree.h"
+
+// key 타입별로 rbtree.c와 같은 알고리즘을 inline 함수로 찍어내는 macro
+//
+//   RBTREE_DEFINE(prefix, key_type, less_expr)
+//
+// less_expr은 key_type 값 a, b에 대해 a가 b보다 앞이면 참인 식이다. 비교가 함수 포인터가 아니라
+// 식으로 들어가기 때문에 int 버전과 같은 수준으로 inline 된다.
+//
+//   RBTREE_DEFINE(i64, int64_t, a < b)
+//   RBTREE_DEFINE(f64, double, a < b)
+//   RBTREE_DEFINE(pt, point_t, a.x < b.x || (a.x == b.x && a.y < b.y))
+//
+// 만들어지는 타입과 함수 (prefix = i64 일 때)
+//   i64_node_t, i64_tree
+//   i64_new, i64_delete, i64_insert, i64_find, i64_erase, i64_min, i64_max,
+//   i64_next, i64_prev, i64_lower_bound, i64_to_array
+// 같은 key는 rbtree_insert처럼 오른쪽에 들어간다. (multiset)
+
+#define RBTREE_GEN_CHUNK_MIN 64
+#define RBTREE_GEN_CHUNK_MAX 65536
+
+#define RBTREE_DEFINE(prefix, key_type, less_expr)                                        \
+  typedef struct prefix##_node_t {                                                        \
+    color_t color;                                                                        \
+    key_type key;                                                                         \
+    struct prefix##_node_t *parent, *left, *right;                                        \
+  } prefix##_node_t;                                                                      \
+                                                                                          \
+  typedef struct prefix##_chunk_t {                                                       \
+    struct prefix##_chunk_t *next;                                                        \
+    size_t capacity;                                                                      \
+    prefix##_node_t nodes[];                                                              \
+  } prefix##_chunk_t;                                                                     \
+                                                                                          \
+  typedef struct {                                                                        \
+    prefix##_node_t *root;                                                                \
+    prefix##_node_t *nil;                                                                 \
+    size_t size;                                                                          \
+    prefix##_chunk_t *chunks;                                                             \
+    size_t chunk_used;                                                                    \
+    prefix##_node_t *free_list;                                                           \
+    prefix##_node_t nil_node;                                                             \
+  } prefix##_tree;                                                                        \
+                                                                                          \
+  static inline bool prefix##_less(const key_type a, const key_type b) {                  \
+    return (less_expr);                                                                   \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_tree *prefix##_new(void) {                                       \
+    prefix##_tree *t = (prefix##_tree *)calloc(1, sizeof(prefix##_tree));                 \
+    if (t == NULL) {                                                                      \
+      return NULL;                                                                        \
+    }                                                                                     \
+    t->nil = t->root = &t->nil_node;                                                      \
+    t->nil->color = RBTREE_BLACK;                                                         \
+    return t;                                                                             \
+  }                                                                                       \
+                                                                                          \
+  static inline void prefix##_delete(prefix##_tree *t) {                                  \
+    prefix##_chunk_t *chunk = t->chunks;                                                  \
+    while (chunk != NULL) {                                                               \
+      prefix##_chunk_t *next = chunk->next;                                               \
+      free(chunk);                                                                        \
+      chunk = next;                                                                       \
+    }                                                                                     \
+    free(t);                                                                              \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_node_t *prefix##_node_alloc(prefix##_tree *t) {                  \
+    if (t->free_list != NULL) {                                                           \
+      prefix##_node_t *node = t->free_list;                                               \
+      t->free_list = node->right;                                                         \
+      return node;                                                                        \
+    }                                                                                     \
+    if (t->chunks == NULL || t->chunk_used == t->chunks->capacity) {                      \
+      size_t capacity = RBTREE_GEN_CHUNK_MIN;                                             \
+      if (t->chunks != NULL) {                                                            \
+        capacity = t->chunks->capacity < RBTREE_GEN_CHUNK_MAX ? t->chunks->capacity * 2   \
+                                                              : RBTREE_GEN_CHUNK_MAX;     \
+      }                                                                                   \
+      prefix##_chunk_t *chunk = (prefix##_chunk_t *)malloc(                               \
+          sizeof(prefix##_chunk_t) + capacity * sizeof(prefix##_node_t));                 \
+      if (chunk == NULL) {                                                                \
+        return NULL;                                                                      \
+      }                                                                                   \
+      chunk->capacity = capacity;                                                         \
+      chunk->next = t->chunks;                                                            \
+      t->chunks = chunk;                                                                  \
+      t->chunk_used = 0;                                                                  \
+    }                                                                                     \
+    return &t->chunks->nodes[t->chunk_used++];                                            \
+  }                                                                                       \
+                                                                                          \
+  static inline void prefix##_node_free(prefix##_tree *t, prefix##_node_t *node) {        \
+    node->right = t->free_list;                                                           \
+    t->free_list = node;                                                                  \
+  }                                                                                       \
+                                                                                          \
+  /* node를 부모 자리로 올린다. (node는 부모의 오른쪽 자식) */                            \
+  static inline void prefix##_rotate_L(prefix##_tree *t, prefix##_node_t *node) {         \
+    prefix##_node_t *parent_node = node->parent;                                          \
+    prefix##_node_t *grand_parent_node = parent_node->parent;                             \
+    prefix##_node_t *left_node = node->left;                                              \
+    if (parent_node == t->root) {                                                         \
+      t->root = node;                                                                     \
+    } else if (grand_parent_node->left == parent_node) {                                  \
+      grand_parent_node->left = node;                                                     \
+    } else {                                                                              \
+      grand_parent_node->right = node;                                                    \
+    }                                                                                     \
+    node->parent = grand_parent_node;                                                     \
+    parent_node->parent = node;                                                           \
+    node->left = parent_node;                                                             \
+    parent_node->right = left_node;                                                       \
+    left_node->parent = parent_node;                                                      \
+  }                                                                                       \
+                                                                                          \
+  /* node를 부모 자리로 올린다. (node는 부모의 왼쪽 자식) */                              \
+  static inline void prefix##_rotate_R(prefix##_tree *t, prefix##_node_t *node) {         \
+    prefix##_node_t *parent_node = node->parent;                                          \
+    prefix##_node_t *grand_parent_node = parent_node->parent;                             \
+    prefix##_node_t *right_node = node->right;                                            \
+    if (parent_node == t->root) {                                                         \
+      t->root = node;                                                                     \
+    } else if (grand_parent_node->left == parent_node) {                                  \
+      grand_parent_node->left = node;                                                     \
+    } else {                                                                              \
+      grand_parent_node->right = node;                                                    \
+    }                                                                                     \
+    node->parent = grand_parent_node;                                                     \
+    parent_node->parent = node;                                                           \
+    node->right = parent_node;                                                            \
+    right_node->parent = parent_node;                                                     \
+    parent_node->left = right_node;                                                       \
+  }                                                                                       \
+                                                                                          \
+  /* rbtree_insert_fixup의 재귀(case 1)를 반복문으로 바꾼 것 */                           \
+  static inline void prefix##_insert_fixup(prefix##_tree *t, prefix##_node_t *node) {     \
+    while (node != t->root && node->parent->color == RBTREE_RED) {                       \
+      prefix##_node_t *parent_node = node->parent;                                        \
+      prefix##_node_t *grand_parent_node = parent_node->parent;                           \
+      bool is_left_node = node == parent_node->left;                                      \
+      bool is_left_parent_node = parent_node == grand_parent_node->left;                  \
+      prefix##_node_t *uncle_node =                                                       \
+          is_left_parent_node ? grand_parent_node->right : grand_parent_node->left;       \
+      if (uncle_node->color == RBTREE_RED) {                                              \
+        parent_node->color = RBTREE_BLACK;                                                \
+        uncle_node->color = RBTREE_BLACK;                                                 \
+        grand_parent_node->color = RBTREE_RED;                                            \
+        node = grand_parent_node;                                                         \
+        continue;                                                                         \
+      }                                                                                   \
+      if (is_left_parent_node) {                                                          \
+        if (is_left_node) {                                                               \
+          prefix##_rotate_R(t, parent_node);                                              \
+          parent_node->color = RBTREE_BLACK;                                              \
+          parent_node->right->color = RBTREE_RED;                                         \
+        } else {                                                                          \
+          prefix##_rotate_L(t, node);                                                     \
+          prefix##_rotate_R(t, node);                                                     \
+          node->color = RBTREE_BLACK;                                                     \
+          node->right->color = RBTREE_RED;                                                \
+        }                                                                                 \
+      } else {                                                                            \
+        if (is_left_node) {                                                               \
+          prefix##_rotate_R(t, node);                                                     \
+          prefix##_rotate_L(t, node);                                                     \
+          node->color = RBTREE_BLACK;                                                     \
+          node->left->color = RBTREE_RED;                                                 \
+        } else {                                                                          \
+          prefix##_rotate_L(t, parent_node);                                              \
+          parent_node->color = RBTREE_BLACK;                                              \
+          parent_node->left->color = RBTREE_RED;                                          \
+        }                                                                                 \
+      }                                                                                   \
+      return;                                                                             \
+    }                                                                                     \
+    t->root->color = RBTREE_BLACK;                                                        \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_node_t *prefix##_insert(prefix##_tree *t, const key_type key) {  \
+    prefix##_node_t *new_node = prefix##_node_alloc(t);                                   \
+    if (new_node == NULL) {                                                               \
+      return NULL;                                                                        \
+    }                                                                                     \
+    new_node->color = RBTREE_RED;                                                         \
+    new_node->left = new_node->right = t->nil;                                            \
+    new_node->key = key;                                                                  \
+    prefix##_node_t *parent_node = t->nil;                                                \
+    prefix##_node_t *current_node = t->root;                                              \
+    bool is_left = false;                                                                 \
+    while (current_node != t->nil) {                                                      \
+      parent_node = current_node;                                                         \
+      is_left = prefix##_less(key, current_node->key);                                    \
+      current_node = is_left ? current_node->left : current_node->right;                  \
+    }                                                                                     \
+    new_node->parent = parent_node;                                                       \
+    if (parent_node == t->nil) {                                                          \
+      t->root = new_node;                                                                 \
+    } else if (is_left) {                                                                 \
+      parent_node->left = new_node;                                                       \
+    } else {                                                                              \
+      parent_node->right = new_node;                                                      \
+    }                                                                                     \
+    t->size++;                                                                            \
+    prefix##_insert_fixup(t, new_node);                                                   \
+    return new_node;                                                                      \
+  }                                                                                       \
+                                                                                          \
+  /* 두 비교를 모두 먼저 계산해야 (&&로 끊지 않아야) rbtree_find처럼 cmov로 내려간다. */  \
+  static inline prefix##_node_t *prefix##_find(const prefix##_tree *t,                    \
+                                               const key_type key) {                      \
+    prefix##_node_t *current_node = t->root;                                              \
+    while (current_node != t->nil) {                                                      \
+      bool is_less = prefix##_less(key, current_node->key);                               \
+      bool is_greater = prefix##_less(current_node->key, key);                            \
+      if (!(is_less | is_greater)) {                                                      \
+        return current_node;                                                              \
+      }                                                                                   \
+      current_node = is_less ? current_node->left : current_node->right;                  \
+    }                                                                                     \
+    return NULL;                                                                          \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_node_t *prefix##_lower_bound(const prefix##_tree *t,             \
+                                                      const key_type key) {               \
+    prefix##_node_t *result = NULL;                                                       \
+    prefix##_node_t *current_node = t->root;                                              \
+    while (current_node != t->nil) {                                                      \
+      if (prefix##_less(current_node->key, key)) {                                        \
+        current_node = current_node->right;                                               \
+      } else {                                                                            \
+        result = current_node;                                                            \
+        current_node = current_node->left;                                                \
+      }                                                                                   \
+    }                                                                                     \
+    return result;                                                                        \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_node_t *prefix##_subtree_min(const prefix##_tree *t,             \
+                                                      prefix##_node_t *node) {            \
+    while (node->left != t->nil) {                                                        \
+      node = node->left;                                                                  \
+    }                                                                                     \
+    return node;                                                                          \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_node_t *prefix##_min(const prefix##_tree *t) {                   \
+    return t->root == t->nil ? NULL : prefix##_subtree_min(t, t->root);                   \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_node_t *prefix##_max(const prefix##_tree *t) {                   \
+    prefix##_node_t *node = t->root;                                                      \
+    if (node == t->nil) {                                                                 \
+      return NULL;                                                                        \
+    }                                                                                     \
+    while (node->right != t->nil) {                                                       \
+      node = node->right;                                                                 \
+    }                                                                                     \
+    return node;                                                                          \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_node_t *prefix##_next(const prefix##_tree *t,                    \
+                                               const prefix##_node_t *node) {             \
+    if (node->right != t->nil) {                                                          \
+      return prefix##_subtree_min(t, node->right);                                        \
+    }                                                                                     \
+    prefix##_node_t *parent = node->parent;                                               \
+    while (parent != t->nil && node == parent->right) {                                   \
+      node = parent;                                                                      \
+      parent = parent->parent;                                                            \
+    }                                                                                     \
+    return parent != t->nil ? parent : NULL;                                              \
+  }                                                                                       \
+                                                                                          \
+  static inline prefix##_node_t *prefix##_prev(const prefix##_tree *t,                    \
+                                               const prefix##_node_t *node) {             \
+    if (node->left != t->nil) {                                                           \
+      prefix##_node_t *current_node = node->left;                                         \
+      while (current_node->right != t->nil) {                                             \
+        current_node = current_node->right;                                               \
+      }                                                                                   \
+      return current_node;                                                                \
+    }                                                                                     \
+    prefix##_node_t *parent = node->parent;                                               \
+    while (parent != t->nil && node == parent->left) {                                    \
+      node = parent;                                                                      \
+      parent = parent->parent;                                                            \
+    }                                                                                     \
+    return parent != t->nil ? parent : NULL;                                              \
+  }                                                                                       \
+                                                                                          \
+  /* rbtree_erase_fixup의 재귀를 반복문으로 바꾼 것 */                                    \
+  static inline void prefix##_erase_fixup(prefix##_tree *t, prefix##_node_t *parent_node, \
+                                          bool is_node_left) {                            \
+    for (;;) {                                                                            \
+      prefix##_node_t *extra_black = is_node_left ? parent_node->left : parent_node->right; \
+      if (extra_black->color == RBTREE_RED) {                                             \
+        extra_black->color = RBTREE_BLACK;                                                \
+        return;                                                                           \
+      }                                                                                   \
+      prefix##_node_t *sibling_node = is_node_left ? parent_node->right : parent_node->left; \
+      if (sibling_node->color == RBTREE_RED) {                                            \
+        if (is_node_left) {                                                               \
+          prefix##_rotate_L(t, sibling_node);                                             \
+        } else {                                                                          \
+          prefix##_rotate_R(t, sibling_node);                                             \
+        }                                                                                 \
+        sibling_node->color = RBTREE_BLACK;                                               \
+        parent_node->color = RBTREE_RED;                                                  \
+        continue;                                                                         \
+      }                                                                                   \
+      prefix##_node_t *near = is_node_left ? sibling_node->left : sibling_node->right;    \
+      prefix##_node_t *distant = is_node_left ? sibling_node->right : sibling_node->left; \
+      if (near->color == RBTREE_RED && distant->color == RBTREE_BLACK) {                  \
+        if (is_node_left) {                                                               \
+          prefix##_rotate_R(t, near);                                                     \
+        } else {                                                                          \
+          prefix##_rotate_L(t, near);                                                     \
+        }                                                                                 \
+        near->color = RBTREE_BLACK;                                                       \
+        sibling_node->color = RBTREE_RED;                                                 \
+        continue;                                                                         \
+      }                                                                                   \
+      if (distant->color == RBTREE_RED) {                                                 \
+        if (is_node_left) {                                                               \
+          prefix##_rotate_L(t, sibling_node);                                             \
+        } else {                                                                          \
+          prefix##_rotate_R(t, sibling_node);                                             \
+        }                                                                                 \
+        sibling_node->color = parent_node->color;                                         \
+        parent_node->color = RBTREE_BLACK;                                                \
+        distant->color = RBTREE_BLACK;                                                    \
+        return;                                                                           \
+      }                                                                                   \
+      sibling_node->color = RBTREE_RED;                                                   \
+      if (parent_node == t->root) {                                                       \
+        return;                                                                           \
+      }                                                                                   \
+      is_node_left = parent_node->parent->left == parent_node;                            \
+      parent_node = parent_node->parent;                                                  \
+    }                                                                                     \
+  }                                                                                       \
+                                                                                          \
+  /* u 자리에 v 서브트리를 연결한다. (u의 자식은 건드리지 않음) */                        \
+  static inline void prefix##_transplant(prefix##_tree *t, prefix##_node_t *u,            \
+                                        prefix##_node_t *v) {                             \
+    if (u->parent == t->nil) {                                                            \
+      t->root = v;                                                                        \
+    } else if (u->parent->left == u) {                                                    \
+      u->parent->left = v;                                                                \
+    } else {                                                                              \
+      u->parent->right = v;                                                               \
+    }                                                                                     \
+    v->parent = u->parent;                                                                \
+  }                                                                                       \
+                                                                                          \
+  /* 자식이 둘이면 successor의 key를 복사하지 않고 successor 노드를 그 자리로 옮긴다. */  \
+  /* key가 큰 타입이어도 복사가 없고, 지우는 노드 말고는 주소와 내용이 그대로다. */       \
+  static inline int prefix##_erase(prefix##_tree *t, prefix##_node_t *check_node) {       \
+    color_t removed_color = check_node->color;                                            \
+    prefix##_node_t *fix_parent;                                                          \
+    bool fix_left;                                                                        \
+    if (check_node->left == t->nil || check_node->right == t->nil) {                      \
+      prefix##_node_t *child =                                                            \
+          check_node->left != t->nil ? check_node->left : check_node->right;              \
+      fix_parent = check_node->parent;                                                    \
+      fix_left = fix_parent != t->nil && fix_parent->left == check_node;                  \
+      prefix##_transplant(t, check_node, child);                                          \
+    } else {                                                                              \
+      prefix##_node_t *successor_node = prefix##_subtree_min(t, check_node->right);       \
+      removed_color = successor_node->color;                                              \
+      if (successor_node->parent == check_node) {                                         \
+        fix_parent = successor_node;                                                      \
+        fix_left = false;                                                                 \
+      } else {                                                                            \
+        fix_parent = successor_node->parent;                                              \
+        fix_left = true;                                                                  \
+        prefix##_transplant(t, successor_node, successor_node->right);                    \
+        successor_node->right = check_node->right;                                        \
+        successor_node->right->parent = successor_node;                                   \
+      }                                                                                   \
+      prefix##_transplant(t, check_node, successor_node);                                 \
+      successor_node->left = check_node->left;                                            \
+      successor_node->left->parent = successor_node;                                      \
+      successor_node->color = check_node->color;                                          \
+    }                                                                                     \
+    t->size--;                                                                            \
+    prefix##_node_free(t, check_node);                                                    \
+    if (fix_parent == t->nil) {                                                           \
+      t->root->color = RBTREE_BLACK;                                                      \
+    } else if (removed_color == RBTREE_BLACK) {                                           \
+      prefix##_erase_fixup(t, fix_parent, fix_left);                                      \
+    }                                                                                     \
+    return 0;                                                                             \
+  }                                                                                       \
+                                                                                          \
+  static inline size_t prefix##_to_array(const prefix##_tree *t, key_type *arr,           \
+                                         const size_t n) {                                \
+    size_t idx = 0;                                                                       \
+    for (prefix##_node_t *node = prefix##_min(t); node != NULL && idx < n;                \
+         node = prefix##_next(t, node)) {                                                 \
+      arr[idx++] = node->key;                                                             \
+    }                                                                                     \
+    return idx;                                                                           \
+  }
+
+#endif  // _RBTREE_GEN_H_
@@ -0,0 +1,31 @@
+#ifndef _RBTREE_IO_H_
+#define _RBTREE_IO_H_
+
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// 파일 형식 (version 1, 이 기계의 byte order)
+//   header: magic, version, key 크기, key 개수
+//   key: 개수만큼 오름차순으로
+//   checksum: key 개수와 모든 key를 64bit word 단위로 섞은 hash (FNV-1a가 아님)
+//     hash = 14695981039346656037
+//     hash = (hash ^ 개수) * 1099511628211          개수는 uint64_t 그대로
+//     hash = (hash ^ (uint32_t)key) * 1099511628211  key마다 파일 순서대로 (0으로 늘린 32bit)
+//     곱셈은 mod 2^64. 파일 끝에 이 기계의 byte order로 8byte
+// byte order가 다른 기계에서 만든 파일은 magic이 달라서 거부된다.
+#define RBTREE_FILE_MAGIC 0x52425431u  // "RBT1"
+#define RBTREE_FILE_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t key_size;
+  uint64_t count;
+} rbtree_file_header;
+
+int rbtree_save(const rbtree *, int);
+rbtree *rbtree_load(int);
+rbtree *rbtree_load_mem(const void *, size_t);
+
+#endif  // _RBTREE_IO_H_
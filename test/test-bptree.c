@@ -0,0 +1,153 @@
+#include <assert.h>
+#include <bptree.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// same fill limits as src/bptree.c: non-root nodes never drop below a quarter
+#define LEAF_MIN (BPTREE_LEAF_KEYS / 4)
+#define INNER_MIN (BPTREE_INNER_KEYS / 4)
+
+static int comp(const void *p1, const void *p2) {
+  const key_t e1 = *(const key_t *)p1;
+  const key_t e2 = *(const key_t *)p2;
+  return (e1 > e2) - (e1 < e2);
+}
+
+// every key in the subtree lies in [lo, hi], all leaves are at the same depth,
+// non-root nodes are at least a quarter full, and leaves appear in the next-linked order
+static size_t check_subtree(const void *node, const int height, const bool root, const long lo, const long hi,
+                            const bptree_leaf **leaf) {
+  if (height == 0) {
+    const bptree_leaf *p = (const bptree_leaf *)node;
+    assert(p == *leaf);
+    assert(p->n <= BPTREE_LEAF_KEYS);
+    assert(root || p->n >= LEAF_MIN);
+    for (uint32_t i = 0; i < p->n; i++) {
+      assert(p->keys[i] >= lo && p->keys[i] <= hi);
+      assert(i == 0 || p->keys[i - 1] <= p->keys[i]);
+    }
+    *leaf = p->next;
+    return p->n;
+  }
+  const bptree_inner *p = (const bptree_inner *)node;
+  assert(p->n <= BPTREE_INNER_KEYS);
+  assert(p->n >= (root ? 1 : INNER_MIN));
+  size_t count = 0;
+  for (uint32_t i = 0; i <= p->n; i++) {
+    const long child_lo = i == 0 ? lo : p->keys[i - 1];
+    const long child_hi = i == p->n ? hi : p->keys[i];
+    assert(child_lo <= child_hi);
+    count += check_subtree(p->children[i], height - 1, false, child_lo, child_hi, leaf);
+  }
+  return count;
+}
+
+static void check_constraints(const bptree *t) {
+  const bptree_leaf *leaf = t->first;
+  assert(check_subtree(t->root, t->height, true, LONG_MIN, LONG_MAX, &leaf) == t->size);
+  assert(leaf == NULL);
+}
+
+// the inner node's count and keys fill exactly one cache line; leaves are four lines
+void test_node_size(void) {
+  assert(offsetof(bptree_inner, children) == 64);
+  assert(sizeof(bptree_inner) % 64 == 0);
+  assert(sizeof(bptree_leaf) == 256);
+}
+
+// ascending and descending inserts split only at one edge; erasing everything merges back down to one leaf
+void test_sorted(const int n) {
+  bptree *t = new_bptree();
+  assert(bptree_min(t) == NULL && bptree_max(t) == NULL && bptree_find(t, 0) == NULL);
+  for (int i = 0; i < n; i++) {
+    assert(bptree_insert(t, i) == 0);
+    assert(bptree_insert(t, -i - 1) == 0);
+  }
+  check_constraints(t);
+  assert(t->height > 1);
+  assert(*bptree_min(t) == -n && *bptree_max(t) == n - 1);
+  for (int i = -n; i < n; i++) {
+    assert(bptree_find(t, i) != NULL && *bptree_find(t, i) == i);
+  }
+  assert(bptree_find(t, n) == NULL && bptree_erase(t, n) == -1);
+  for (int i = 0; i < n; i++) {
+    assert(bptree_erase(t, i) == 0);
+    assert(bptree_erase(t, -i - 1) == 0);
+    if (i % 500 == 0) {
+      check_constraints(t);
+    }
+  }
+  assert(t->size == 0 && t->height == 0 && t->root == t->first);
+  assert(bptree_min(t) == NULL && bptree_erase(t, 0) == -1);
+  delete_bptree(t);
+}
+
+// random insert/erase with duplicates should keep the same multiset as a sorted reference
+void test_bptree_rand(const size_t n, const unsigned int seed) {
+  srand(seed);
+  bptree *t = new_bptree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  key_t *res = calloc(n, sizeof(key_t));
+  // narrow key range so runs of equal keys span several leaves; the extremes exercise signed comparison
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = i % 97 == 0 ? (i % 2 ? INT_MAX : INT_MIN) : rand() % (int)(n / 8) - (int)(n / 16);
+    assert(bptree_insert(t, arr[i]) == 0);
+  }
+  assert(t->size == n);
+  check_constraints(t);
+
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  assert(bptree_to_array(t, res, n) == n);
+  for (size_t i = 0; i < n; i++) {
+    assert(arr[i] == res[i]);
+  }
+  assert(bptree_to_array(t, res, 10) == 10 && res[9] == arr[9]);
+  assert(*bptree_min(t) == INT_MIN && *bptree_max(t) == INT_MAX);
+
+  // erase a random half; every present key must still be found, erased-out keys must not
+  size_t m = n;
+  for (size_t i = 0; i < n / 2; i++) {
+    const size_t j = (size_t)rand() % m;
+    const key_t key = arr[j];
+    assert(bptree_find(t, key) != NULL);
+    assert(bptree_erase(t, key) == 0);
+    arr[j] = arr[--m];
+    if (i % 1000 == 0) {
+      check_constraints(t);
+    }
+  }
+  check_constraints(t);
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  assert(t->size == m && bptree_to_array(t, res, n) == m);
+  for (size_t i = 0; i < m; i++) {
+    assert(arr[i] == res[i]);
+    assert(bptree_find(t, arr[i]) != NULL);
+  }
+  for (key_t key = -(int)(n / 16) - 2; key < (int)(n / 16) + 2; key++) {
+    const key_t *found = bptree_find(t, key);
+    const bool present = bsearch(&key, arr, m, sizeof(key_t), comp) != NULL;
+    assert(present == (found != NULL));
+    assert(found == NULL || *found == key);
+  }
+
+  for (size_t i = 0; i < m; i++) {
+    assert(bptree_erase(t, arr[i]) == 0);
+  }
+  assert(t->size == 0 && t->height == 0);
+  check_constraints(t);
+
+  free(res);
+  free(arr);
+  delete_bptree(t);
+}
+
+int main(void) {
+  test_node_size();
+  test_sorted(5000);
+  test_bptree_rand(20000, 61);
+  test_bptree_rand(3000, 67);
+  printf("Passed all tests!\n");
+}
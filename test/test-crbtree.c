@@ -0,0 +1,145 @@
+#include <assert.h>
+#include <crbtree.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int comp(const void *p1, const void *p2) {
+  const key_t e1 = *(const key_t *)p1;
+  const key_t e2 = *(const key_t *)p2;
+  return (e1 > e2) - (e1 < e2);
+}
+
+// search order, no red node with a red child and equal black count on every path
+static int check_subtree(const crbtree *t, const uint32_t id) {
+  if (id == CRBTREE_NIL) {
+    return 1;
+  }
+  const cnode_t *p = &t->nodes[id];
+  const color_t color = (color_t)(p->parent_color & 1);
+  if (p->left != CRBTREE_NIL) {
+    assert(t->nodes[p->left].key <= p->key);
+    assert(t->nodes[p->left].parent_color >> 1 == id);
+  }
+  if (p->right != CRBTREE_NIL) {
+    assert(t->nodes[p->right].key >= p->key);
+    assert(t->nodes[p->right].parent_color >> 1 == id);
+  }
+  if (color == RBTREE_RED) {
+    assert((t->nodes[p->left].parent_color & 1) == RBTREE_BLACK);
+    assert((t->nodes[p->right].parent_color & 1) == RBTREE_BLACK);
+  }
+  const int l = check_subtree(t, p->left);
+  const int r = check_subtree(t, p->right);
+  assert(l == r);
+  return l + (color == RBTREE_BLACK ? 1 : 0);
+}
+
+static void check_constraints(const crbtree *t) {
+  assert(t->root == CRBTREE_NIL || (t->nodes[t->root].parent_color & 1) == RBTREE_BLACK);
+  check_subtree(t, t->root);
+}
+
+// index-linked nodes should be half the size of node_t
+void test_node_size(void) {
+  assert(sizeof(cnode_t) == 16);
+  assert(sizeof(cnode_t) * 2 == sizeof(node_t));
+}
+
+// compact tree should behave like rbtree under random insert/erase with duplicates
+void test_crbtree_rand(const size_t n, const unsigned int seed) {
+  srand(seed);
+  crbtree *t = new_crbtree();
+  assert(t != NULL);
+  assert(crbtree_min(t) == CRBTREE_NIL);
+
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++) {
+    arr[i] = rand() % n;
+    const uint32_t id = crbtree_insert(t, arr[i]);
+    assert(id != CRBTREE_NIL);
+    assert(crbtree_key(t, id) == arr[i]);
+  }
+  assert(t->size == n);
+  check_constraints(t);
+
+  key_t *res = calloc(n, sizeof(key_t));
+  assert(crbtree_to_array(t, res, n) == n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  for (int i = 0; i < n; i++) {
+    assert(arr[i] == res[i]);
+  }
+  assert(crbtree_key(t, crbtree_min(t)) == arr[0]);
+  assert(crbtree_key(t, crbtree_max(t)) == arr[n - 1]);
+
+  int i = n - 1;
+  for (uint32_t id = crbtree_max(t); id != CRBTREE_NIL; id = crbtree_prev(t, id)) {
+    assert(crbtree_key(t, id) == arr[i--]);
+  }
+  assert(i == -1);
+
+  for (i = 0; i < n; i++) {
+    const uint32_t id = crbtree_find(t, arr[i]);
+    assert(id != CRBTREE_NIL);
+    crbtree_erase(t, id);
+    if (i % 100 == 0) {
+      check_constraints(t);
+    }
+  }
+  assert(t->size == 0);
+  assert(t->root == CRBTREE_NIL);
+
+  // freed indices are reused before the array grows
+  const uint32_t used = t->used;
+  for (i = 0; i < n; i++) {
+    crbtree_insert(t, i);
+  }
+  assert(t->used == used);
+  check_constraints(t);
+
+  free(res);
+  free(arr);
+  delete_crbtree(t);
+}
+
+// erase should unlink the erased node only: every index held by the caller keeps its key
+void test_erase_keeps_indices(const size_t n, const unsigned int seed) {
+  srand(seed);
+  crbtree *t = new_crbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  uint32_t *ids = calloc(n, sizeof(uint32_t));
+  for (int i = 0; i < n; i++) {
+    arr[i] = i;
+  }
+  for (int i = n - 1; i > 0; i--) {
+    const int j = rand() % (i + 1);
+    const key_t tmp = arr[i];
+    arr[i] = arr[j];
+    arr[j] = tmp;
+  }
+  for (int i = 0; i < n; i++) {
+    ids[i] = crbtree_insert(t, arr[i]);
+  }
+  // erase in insertion order: many of them have two children and a live successor
+  for (int i = 0; i < n; i++) {
+    assert(crbtree_find(t, arr[i]) == ids[i]);
+    crbtree_erase(t, ids[i]);
+    if (i % 97 == 0) {
+      for (int j = i + 1; j < n; j++) {
+        assert(crbtree_key(t, ids[j]) == arr[j]);
+      }
+      check_constraints(t);
+    }
+  }
+  assert(t->size == 0 && t->root == CRBTREE_NIL);
+  free(ids);
+  free(arr);
+  delete_crbtree(t);
+}
+
+int main(void) {
+  test_node_size();
+  test_crbtree_rand(10000, 31);
+  test_erase_keeps_indices(2000, 61);
+  printf("Passed all tests!\n");
+}
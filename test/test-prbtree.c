@@ -0,0 +1,168 @@
+#include <assert.h>
+#include <prbtree.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int comp(const void *p1, const void *p2) {
+  const key_t e1 = *(const key_t *)p1;
+  const key_t e2 = *(const key_t *)p2;
+  return (e1 > e2) - (e1 < e2);
+}
+
+// search order, left-leaning red links only, no two reds in a row, equal black count
+static int check_subtree(const pnode_t *p) {
+  if (p == NULL) {
+    return 1;
+  }
+  assert(p->ref >= 1);
+  assert(p->right == NULL || p->right->color == RBTREE_BLACK);
+  if (p->left != NULL) {
+    assert(p->left->key <= p->key);
+    assert(p->color == RBTREE_BLACK || p->left->color == RBTREE_BLACK);
+  }
+  if (p->right != NULL) {
+    assert(p->right->key >= p->key);
+  }
+  const int l = check_subtree(p->left);
+  const int r = check_subtree(p->right);
+  assert(l == r);
+  return l + (p->color == RBTREE_BLACK ? 1 : 0);
+}
+
+// t의 내용이 정렬된 arr[0..n)과 같은지
+static void check_tree(const prbtree *t, const key_t *arr, const size_t n) {
+  assert(t->root == NULL || t->root->color == RBTREE_BLACK);
+  check_subtree(t->root);
+  assert(t->size == n);
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(prbtree_to_array(t, res, n + 1) == n);
+  assert(memcmp(res, arr, n * sizeof(key_t)) == 0);
+  if (n > 0) {
+    assert(prbtree_min(t)->key == arr[0]);
+    assert(prbtree_max(t)->key == arr[n - 1]);
+  } else {
+    assert(prbtree_min(t) == NULL && prbtree_max(t) == NULL);
+  }
+  free(res);
+}
+
+// 일정 간격으로 snapshot을 남기면서 insert/erase 하고, 나중에 snapshot이 그때 내용 그대로인지 확인
+void test_snapshots(const size_t n, const size_t every) {
+  const size_t count = n / every + 1;
+  prbtree *t = new_prbtree();
+  prbtree **snapshots = calloc(count, sizeof(prbtree *));
+  key_t **expected = calloc(count, sizeof(key_t *));
+  size_t *sizes = calloc(count, sizeof(size_t));
+  key_t *keys = calloc(n, sizeof(key_t));
+  size_t num = 0, taken = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    if (num > 0 && rand() % 3 == 0) {
+      const size_t j = rand() % num;
+      assert(prbtree_erase(t, keys[j]) == 0);
+      keys[j] = keys[--num];
+    } else {
+      keys[num] = rand() % (n / 2);  // 중복 key 포함
+      assert(prbtree_insert(t, keys[num++]) == 0);
+    }
+    if (i % every == 0) {
+      snapshots[taken] = prbtree_snapshot(t);
+      expected[taken] = calloc(num + 1, sizeof(key_t));
+      memcpy(expected[taken], keys, num * sizeof(key_t));
+      qsort(expected[taken], num, sizeof(key_t), comp);
+      sizes[taken++] = num;
+    }
+  }
+  assert(prbtree_erase(t, -1) == -1);
+
+  qsort(keys, num, sizeof(key_t), comp);
+  check_tree(t, keys, num);
+  for (size_t i = 0; i < taken; i++) {
+    check_tree(snapshots[i], expected[i], sizes[i]);
+  }
+  // snapshot을 섞인 순서로 해제해도 남은 version은 그대로
+  for (size_t i = 0; i < taken; i += 2) {
+    delete_prbtree(snapshots[i]);
+  }
+  for (size_t i = 1; i < taken; i += 2) {
+    check_tree(snapshots[i], expected[i], sizes[i]);
+    delete_prbtree(snapshots[i]);
+  }
+  check_tree(t, keys, num);
+  delete_prbtree(t);
+
+  for (size_t i = 0; i < taken; i++) {
+    free(expected[i]);
+  }
+  free(snapshots);
+  free(expected);
+  free(sizes);
+  free(keys);
+}
+
+// snapshot은 그 자체로 수정할 수 있는 독립된 version이다.
+void test_fork(void) {
+  prbtree *t = new_prbtree();
+  for (int i = 0; i < 100; i++) {
+    assert(prbtree_insert(t, i) == 0);
+  }
+  prbtree *s = prbtree_snapshot(t);
+  for (int i = 0; i < 100; i += 2) {
+    assert(prbtree_erase(t, i) == 0);
+    assert(prbtree_insert(s, 100 + i) == 0);
+  }
+  assert(prbtree_find(t, 0) == NULL && prbtree_find(s, 0) != NULL);
+  assert(prbtree_find(t, 100) == NULL && prbtree_find(s, 100) != NULL);
+  assert(t->size == 50 && s->size == 150);
+  delete_prbtree(t);
+  assert(prbtree_find(s, 99) != NULL);
+  delete_prbtree(s);
+}
+
+typedef struct {
+  prbtree *snapshot;
+  size_t n;
+} reader_arg;
+
+static void *reader(void *p) {
+  reader_arg *arg = (reader_arg *)p;
+  key_t *arr = calloc(arg->n, sizeof(key_t));
+  for (int round = 0; round < 20; round++) {
+    assert(prbtree_to_array(arg->snapshot, arr, arg->n) == arg->n);
+    for (size_t i = 0; i < arg->n; i++) {
+      assert(arr[i] == (key_t)i);
+    }
+  }
+  free(arr);
+  delete_prbtree(arg->snapshot);
+  return NULL;
+}
+
+// writer가 계속 수정하는 동안 다른 thread가 snapshot을 읽고 해제한다.
+void test_concurrent_reader(const size_t n) {
+  prbtree *t = new_prbtree();
+  for (size_t i = 0; i < n; i++) {
+    assert(prbtree_insert(t, (key_t)i) == 0);
+  }
+  reader_arg arg = {prbtree_snapshot(t), n};
+  pthread_t thread;
+  pthread_create(&thread, NULL, reader, &arg);
+  for (size_t i = 0; i < n; i++) {
+    assert(prbtree_erase(t, (key_t)i) == 0);
+    assert(prbtree_insert(t, (key_t)(i + n)) == 0);
+  }
+  pthread_join(thread, NULL);
+  assert(t->size == n && prbtree_min(t)->key == (key_t)n);
+  delete_prbtree(t);
+}
+
+int main(void) {
+  test_snapshots(10000, 1);
+  test_snapshots(20000, 97);
+  test_fork();
+  test_concurrent_reader(20000);
+  printf("Passed all tests!\n");
+}
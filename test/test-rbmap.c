@@ -0,0 +1,161 @@
+#include <assert.h>
+#include <rbmap.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  long id;
+  double weight;
+} record_t;
+
+// a 16-byte key that needs 16-byte alignment
+typedef struct {
+  _Alignas(16) long hi;
+  long lo;
+} wide_key_t;
+
+static int long_comp(const void *p1, const void *p2) {
+  const long k1 = *(const long *)p1;
+  const long k2 = *(const long *)p2;
+  return (k1 > k2) - (k1 < k2);
+}
+
+static int wide_comp(const void *p1, const void *p2) {
+  const wide_key_t *k1 = p1, *k2 = p2;
+  if (k1->hi != k2->hi) {
+    return (k1->hi > k2->hi) - (k1->hi < k2->hi);
+  }
+  return (k1->lo > k2->lo) - (k1->lo < k2->lo);
+}
+
+static int str_comp(const void *p1, const void *p2) {
+  return strcmp(*(const char *const *)p1, *(const char *const *)p2);
+}
+
+// every path from the root should hold the same number of black nodes and no red node
+// should have a red child
+static int black_height(const rbtree *t, const node_t *p) {
+  if (p == t->nil) {
+    return 1;
+  }
+  if (rbtree_color(p) == RBTREE_RED) {
+    assert(rbtree_color(p->left) == RBTREE_BLACK && rbtree_color(p->right) == RBTREE_BLACK);
+  }
+  const int l = black_height(t, p->left);
+  const int r = black_height(t, p->right);
+  assert(l == r);
+  return l + (rbtree_color(p) == RBTREE_BLACK ? 1 : 0);
+}
+
+// insert/find/erase with inline struct values should behave like a map
+void test_map_inline_value(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbmap *m = new_rbmap(sizeof(long), sizeof(record_t), long_comp);
+  assert(m != NULL);
+
+  for (long i = 0; i < n; i++) {
+    const long key = i * 7919 % n;
+    record_t r = {key, key * 0.5};
+    record_t *slot = rbmap_insert(m, &key, &r);
+    assert(slot != NULL);
+    assert(slot->id == key);
+  }
+  assert(m->tree->size == n);
+  black_height(m->tree, m->tree->root);
+
+  // insert on an existing key overwrites the value
+  const long key = 3;
+  record_t r = {-1, -1.0};
+  rbmap_insert(m, &key, &r);
+  assert(m->tree->size == n);
+  assert(((record_t *)rbmap_find(m, &key))->id == -1);
+
+  // in-order walk through the underlying tree gives sorted keys
+  long expected = 0;
+  for (node_t *p = rbtree_min(m->tree); p != NULL; p = rbtree_next(m->tree, p)) {
+    assert(*(long *)rbmap_key(p) == expected);
+    expected++;
+  }
+  assert(expected == n);
+
+  // value pointers of the remaining keys survive erasing their neighbours
+  record_t **slots = calloc(n, sizeof(record_t *));
+  for (long i = 0; i < n; i++) {
+    slots[i] = rbmap_find(m, &i);
+  }
+  for (long i = 0; i < n; i += 2) {
+    assert(rbmap_erase(m, &i) == 0);
+    assert(rbmap_erase(m, &i) == -1);
+  }
+  black_height(m->tree, m->tree->root);
+  for (long i = 0; i < n; i++) {
+    record_t *found = rbmap_find(m, &i);
+    if (i % 2 == 0) {
+      assert(found == NULL);
+    } else {
+      assert(found == slots[i]);
+      assert(i == 3 ? found->id == -1 : found->id == i && found->weight == i * 0.5);
+    }
+  }
+
+  free(slots);
+  delete_rbmap(m);
+}
+
+// keys can be pointers compared through the callback, values can be payload pointers
+void test_map_string_keys(void) {
+  const char *words[] = {"pear", "apple", "fig", "kiwi", "banana", "cherry", "grape"};
+  const size_t n = sizeof(words) / sizeof(words[0]);
+  rbmap *m = new_rbmap(sizeof(char *), sizeof(void *), str_comp);
+
+  for (int i = 0; i < n; i++) {
+    const void *payload = words[i];
+    rbmap_insert(m, &words[i], &payload);
+  }
+  char buf[16];
+  strcpy(buf, "kiwi");
+  const char *key = buf;
+  void **value = rbmap_find(m, &key);
+  assert(value != NULL);
+  assert(*value == words[3]);
+
+  const char *prev = "";
+  for (node_t *p = rbtree_min(m->tree); p != NULL; p = rbtree_next(m->tree, p)) {
+    const char *word = *(const char **)rbmap_key(p);
+    assert(strcmp(prev, word) < 0);
+    prev = word;
+  }
+
+  strcpy(buf, "mango");
+  assert(rbmap_find(m, &key) == NULL);
+  delete_rbmap(m);
+}
+
+// keys and values stay aligned for their type whatever the size of node_t in this build
+void test_map_aligned_keys(const size_t n) {
+  rbmap *m = new_rbmap(sizeof(wide_key_t), sizeof(wide_key_t), wide_comp);
+  for (long i = 0; i < n; i++) {
+    const wide_key_t key = {i % 7, i};
+    wide_key_t *slot = rbmap_insert(m, &key, &key);
+    assert(slot != NULL && (uintptr_t)slot % _Alignof(wide_key_t) == 0);
+  }
+  long count = 0;
+  for (node_t *p = rbtree_min(m->tree); p != NULL; p = rbtree_next(m->tree, p)) {
+    const wide_key_t *key = rbmap_key(p);
+    assert((uintptr_t)key % _Alignof(wide_key_t) == 0);
+    assert(((wide_key_t *)rbmap_value(m, p))->lo == key->lo);
+    count++;
+  }
+  assert(count == n);
+  delete_rbmap(m);
+}
+
+int main(void) {
+  test_map_inline_value(1000, 23);
+  test_map_string_keys();
+  test_map_aligned_keys(500);
+  printf("Passed all tests!\n");
+}
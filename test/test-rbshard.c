@@ -0,0 +1,110 @@
+#include <assert.h>
+#include <pthread.h>
+#include <rbshard.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_THREADS 4
+
+typedef struct {
+  rbshard *s;
+  int id;
+  int count;
+} worker_arg;
+
+// thread마다 겹치지 않는 key (id, id + NUM_THREADS, ...) 를 넣고 절반을 지운다.
+static void *worker(void *p) {
+  worker_arg *arg = (worker_arg *)p;
+  for (int i = 0; i < arg->count; i++) {
+    const key_t key = (key_t)((i * NUM_THREADS + arg->id) * 2654435761u);
+    assert(rbshard_insert(arg->s, key) == 0);
+  }
+  for (int i = 0; i < arg->count; i += 2) {
+    const key_t key = (key_t)((i * NUM_THREADS + arg->id) * 2654435761u);
+    assert(rbshard_erase(arg->s, key) == 0);
+  }
+  return NULL;
+}
+
+static bool count_keys(key_t key, void *ctx) {
+  key_t *prev = (key_t *)ctx;
+  assert(prev[1] == 0 || prev[0] <= key);
+  prev[0] = key;
+  prev[1]++;
+  return true;
+}
+
+static void check_sorted(rbshard *s, const size_t n) {
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  assert(rbshard_size(s) == n);
+  assert(rbshard_to_array(s, arr, n + 1) == n);
+  for (size_t i = 1; i < n; i++) {
+    assert(arr[i - 1] <= arr[i]);
+  }
+  if (n > 0) {
+    key_t min, max;
+    assert(rbshard_min(s, &min) && min == arr[0]);
+    assert(rbshard_max(s, &max) && max == arr[n - 1]);
+  }
+  key_t state[2] = {0, 0};
+  rbshard_foreach(s, count_keys, state);
+  assert((size_t)state[1] == n);
+  free(arr);
+}
+
+void test_concurrent(const int count) {
+  rbshard *s = new_rbshard(8);
+  pthread_t threads[NUM_THREADS];
+  worker_arg args[NUM_THREADS];
+  for (int i = 0; i < NUM_THREADS; i++) {
+    args[i] = (worker_arg){s, i, count};
+    pthread_create(&threads[i], NULL, worker, &args[i]);
+  }
+  for (int i = 0; i < NUM_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  check_sorted(s, (size_t)NUM_THREADS * (count / 2));
+  for (int id = 0; id < NUM_THREADS; id++) {
+    for (int i = 0; i < count; i++) {
+      const key_t key = (key_t)((i * NUM_THREADS + id) * 2654435761u);
+      assert(rbshard_contains(s, key) == (i % 2 == 1));
+    }
+  }
+  delete_rbshard(s);
+}
+
+// 한쪽에 몰린 key를 넣은 뒤 rebalance 하면 shard마다 key가 고르게 나뉘고 내용은 그대로
+void test_rebalance(const int n) {
+  rbshard *s = new_rbshard(4);
+  key_t min, max;
+  assert(!rbshard_min(s, &min) && !rbshard_max(s, &max));
+  check_sorted(s, 0);
+  assert(rbshard_rebalance(s) == 0);
+
+  for (int i = 0; i < n; i++) {
+    assert(rbshard_insert(s, i / 3) == 0);
+  }
+  assert(s->parts[0].tree->size == 0 && s->parts[2].tree->size == (size_t)n);
+  assert(rbshard_rebalance(s) == 0);
+  for (size_t i = 0; i < s->n; i++) {
+    assert(s->parts[i].tree->size >= (size_t)n / s->n - 3);
+    assert(s->parts[i].tree->size <= (size_t)n / s->n + 3);
+  }
+  check_sorted(s, n);
+
+  // 경계가 바뀐 뒤에도 모든 key를 찾고 지울 수 있어야 한다.
+  for (int i = 0; i < n; i++) {
+    assert(rbshard_contains(s, i / 3));
+    assert(rbshard_erase(s, i / 3) == 0);
+  }
+  assert(rbshard_erase(s, 0) == -1);
+  check_sorted(s, 0);
+  delete_rbshard(s);
+}
+
+int main(void) {
+  test_concurrent(20000);
+  test_rebalance(1000);
+  printf("Passed all tests!\n");
+}
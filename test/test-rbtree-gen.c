@@ -0,0 +1,141 @@
+#include <assert.h>
+#include <rbtree_gen.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+  int x, y;
+} point_t;
+
+RBTREE_DEFINE(i64, int64_t, a < b)
+RBTREE_DEFINE(f64, double, a < b)
+RBTREE_DEFINE(pt, point_t, a.x < b.x || (a.x == b.x && a.y < b.y))
+
+// rbtree constraints checked on the generated node type through a macro, one per instantiation
+#define CHECK_BLACK_HEIGHT(prefix)                                              \
+  static int prefix##_black_height(const prefix##_tree *t,                     \
+                                   const prefix##_node_t *p) {                 \
+    if (p == t->nil) {                                                         \
+      return 1;                                                                \
+    }                                                                          \
+    if (p->color == RBTREE_RED) {                                              \
+      assert(p->left->color == RBTREE_BLACK);                                  \
+      assert(p->right->color == RBTREE_BLACK);                                 \
+    }                                                                          \
+    if (p->left != t->nil) {                                                   \
+      assert(!prefix##_less(p->key, p->left->key));                            \
+    }                                                                          \
+    if (p->right != t->nil) {                                                  \
+      assert(!prefix##_less(p->right->key, p->key));                           \
+    }                                                                          \
+    const int l = prefix##_black_height(t, p->left);                           \
+    const int r = prefix##_black_height(t, p->right);                          \
+    assert(l == r);                                                            \
+    return l + (p->color == RBTREE_BLACK ? 1 : 0);                             \
+  }
+
+CHECK_BLACK_HEIGHT(i64)
+CHECK_BLACK_HEIGHT(f64)
+CHECK_BLACK_HEIGHT(pt)
+
+// 64-bit keys beyond the int range should insert, find and erase like the int tree
+void test_gen_i64(const size_t n, const unsigned int seed) {
+  srand(seed);
+  i64_tree *t = i64_new();
+  int64_t *arr = calloc(n, sizeof(int64_t));
+  for (int i = 0; i < n; i++) {
+    arr[i] = ((int64_t)rand() << 32) - rand();
+    assert(i64_insert(t, arr[i]) != NULL);
+  }
+  assert(t->size == n);
+  assert(t->root->color == RBTREE_BLACK);
+  i64_black_height(t, t->root);
+
+  int64_t *res = calloc(n, sizeof(int64_t));
+  assert(i64_to_array(t, res, n) == n);
+  for (int i = 1; i < n; i++) {
+    assert(res[i - 1] <= res[i]);
+  }
+  assert(i64_min(t)->key == res[0]);
+  assert(i64_max(t)->key == res[n - 1]);
+
+  // erase relinks nodes instead of copying keys, so every remaining node keeps its address
+  i64_node_t **nodes = calloc(n, sizeof(i64_node_t *));
+  for (int i = 0; i < n; i++) {
+    nodes[i] = i64_find(t, arr[i]);
+  }
+  for (int i = 0; i < n; i++) {
+    i64_node_t *p = i64_find(t, arr[i]);
+    assert(p == nodes[i]);
+    assert(p->key == arr[i]);
+    i64_erase(t, p);
+    if (i % 64 == 0) {
+      i64_black_height(t, t->root);
+    }
+  }
+  assert(t->root == t->nil);
+  assert(i64_min(t) == NULL);
+
+  free(nodes);
+  free(res);
+  free(arr);
+  i64_delete(t);
+}
+
+// float keys with duplicates should iterate in order both ways
+void test_gen_f64(const size_t n) {
+  f64_tree *t = f64_new();
+  for (int i = 0; i < n; i++) {
+    f64_insert(t, (i * 37 % n) / 4.0);
+  }
+  f64_black_height(t, t->root);
+
+  size_t count = 0;
+  double prev = -1.0;
+  for (f64_node_t *p = f64_min(t); p != NULL; p = f64_next(t, p)) {
+    assert(prev <= p->key);
+    prev = p->key;
+    count++;
+  }
+  assert(count == n);
+  for (f64_node_t *p = f64_max(t); p != NULL; p = f64_prev(t, p)) {
+    count--;
+  }
+  assert(count == 0);
+
+  f64_node_t *p = f64_lower_bound(t, 10.1);
+  assert(p != NULL && p->key == 10.25);
+  assert(f64_find(t, 10.1) == NULL);
+
+  f64_delete(t);
+}
+
+// struct keys should be ordered by the given expression
+void test_gen_struct(void) {
+  pt_tree *t = pt_new();
+  for (int x = 0; x < 20; x++) {
+    for (int y = 20; y > 0; y--) {
+      pt_insert(t, (point_t){(x * 7) % 20, y});
+    }
+  }
+  pt_black_height(t, t->root);
+
+  pt_node_t *p = pt_find(t, (point_t){3, 4});
+  assert(p != NULL && p->key.x == 3 && p->key.y == 4);
+  p = pt_next(t, p);
+  assert(p->key.x == 3 && p->key.y == 5);
+  assert(pt_min(t)->key.x == 0 && pt_min(t)->key.y == 1);
+  assert(pt_max(t)->key.x == 19 && pt_max(t)->key.y == 20);
+  assert(pt_find(t, (point_t){3, 21}) == NULL);
+
+  pt_delete(t);
+}
+
+int main(void) {
+  test_gen_i64(10000, 29);
+  test_gen_f64(1000);
+  test_gen_struct();
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,162 @@
+#include <assert.h>
+#include <errno.h>
+#include <rbtree_io.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int comp(const void *p1, const void *p2) {
+  const key_t e1 = *(const key_t *)p1;
+  const key_t e2 = *(const key_t *)p2;
+  return (e1 > e2) - (e1 < e2);
+}
+
+// every path from the root should hold the same number of black nodes and no red node
+// should have a red child
+static int black_height(const rbtree *t, const node_t *p) {
+  if (p == t->nil) {
+    return 1;
+  }
+  if (rbtree_color(p) == RBTREE_RED) {
+    assert(rbtree_color(p->left) == RBTREE_BLACK && rbtree_color(p->right) == RBTREE_BLACK);
+  }
+  if (p->left != t->nil) {
+    assert(rbtree_parent(p->left) == p && p->left->key <= p->key);
+  }
+  if (p->right != t->nil) {
+    assert(rbtree_parent(p->right) == p && p->right->key >= p->key);
+  }
+  const int l = black_height(t, p->left);
+  const int r = black_height(t, p->right);
+  assert(l == r);
+  return l + (rbtree_color(p) == RBTREE_BLACK ? 1 : 0);
+}
+
+static void check_same(const rbtree *t, const key_t *arr, const size_t n) {
+  assert(t != NULL && t->size == n);
+  assert(rbtree_color(t->root) == RBTREE_BLACK);
+  black_height(t, t->root);
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert((size_t)rbtree_to_array(t, res, n + 1) == n);
+  assert(memcmp(res, arr, n * sizeof(key_t)) == 0);
+  free(res);
+}
+
+// key를 저장한 임시 파일을 만들고 fd를 처음 위치로 돌려서 반환
+static int save_to_file(const key_t *arr, const size_t n) {
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, arr[i]);
+  }
+  FILE *f = tmpfile();
+  const int fd = dup(fileno(f));
+  fclose(f);
+  assert(rbtree_save(t, fd) == 0);
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  delete_rbtree(t);
+  return fd;
+}
+
+// save한 트리를 read와 mmap 두 가지로 다시 읽으면 같은 트리가 된다.
+void test_round_trip(const size_t n) {
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % (n + 1) - (key_t)(n / 2);  // 음수와 중복 key 포함
+  }
+  const int fd = save_to_file(arr, n);
+  qsort(arr, n, sizeof(key_t), comp);
+
+  rbtree *t = rbtree_load(fd);
+  check_same(t, arr, n);
+  delete_rbtree(t);
+
+  struct stat st;
+  assert(fstat(fd, &st) == 0);
+  assert((size_t)st.st_size == sizeof(rbtree_file_header) + n * sizeof(key_t) + sizeof(uint64_t));
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  assert(data != MAP_FAILED);
+  t = rbtree_load_mem(data, st.st_size);
+  check_same(t, arr, n);
+  delete_rbtree(t);
+  munmap(data, st.st_size);
+
+  close(fd);
+  free(arr);
+}
+
+// 잘린 파일, 바뀐 key, 정렬이 깨진 key, 다른 형식의 파일은 읽지 않는다.
+void test_corruption(const size_t n) {
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = (key_t)(i * 3);
+  }
+  const int fd = save_to_file(arr, n);
+  const size_t len = sizeof(rbtree_file_header) + n * sizeof(key_t) + sizeof(uint64_t);
+  char *data = malloc(len);
+  assert(read(fd, data, len) == (ssize_t)len);
+  close(fd);
+
+  rbtree *t = rbtree_load_mem(data, len);
+  check_same(t, arr, n);
+  delete_rbtree(t);
+
+  // 파일 끝의 checksum은 rbtree_io.h에 적힌 식으로 다른 쪽에서도 다시 계산할 수 있다.
+  const key_t *saved = (const key_t *)(data + sizeof(rbtree_file_header));
+  uint64_t hash = 14695981039346656037ull;
+  hash = (hash ^ (uint64_t)n) * 1099511628211ull;
+  for (size_t i = 0; i < n; i++) {
+    hash = (hash ^ (uint32_t)saved[i]) * 1099511628211ull;
+  }
+  uint64_t stored;
+  memcpy(&stored, data + len - sizeof(stored), sizeof(stored));
+  assert(stored == hash);
+
+  errno = 0;
+  assert(rbtree_load_mem(data, len - 1) == NULL && errno == EINVAL);
+  assert(rbtree_load_mem(data, 3) == NULL);
+
+  // key 하나를 바꾸면 (순서는 그대로) checksum이 틀린다.
+  key_t *keys = (key_t *)(data + sizeof(rbtree_file_header));
+  keys[n / 2] += 1;
+  assert(rbtree_load_mem(data, len) == NULL);
+  keys[n / 2] -= 1;
+
+  // 순서가 깨진 key
+  const key_t tmp = keys[1];
+  keys[1] = keys[0];
+  keys[0] = tmp;
+  assert(rbtree_load_mem(data, len) == NULL);
+  keys[0] = keys[1];
+  keys[1] = tmp;
+
+  rbtree_file_header *header = (rbtree_file_header *)data;
+  header->version++;
+  assert(rbtree_load_mem(data, len) == NULL);
+  header->version--;
+  header->count = UINT64_MAX;
+  assert(rbtree_load_mem(data, len) == NULL);
+
+  // 스트리밍으로 읽을 때 개수가 파일보다 크면 파일 끝에서 멈춘다.
+  header->count = n + 1;
+  FILE *f = tmpfile();
+  assert(fwrite(data, 1, len, f) == len);
+  fflush(f);
+  rewind(f);
+  assert(rbtree_load(fileno(f)) == NULL);
+  fclose(f);
+
+  free(data);
+  free(arr);
+}
+
+int main(void) {
+  test_round_trip(0);
+  test_round_trip(1);
+  test_round_trip(50000);
+  test_corruption(1000);
+  printf("Passed all tests!\n");
+}
@@ -28,11 +28,15 @@ void test_insert_single(const key_t key) {
 #ifdef SENTINEL
   assert(p->left == t->nil);
   assert(p->right == t->nil);
-  assert(p->parent == t->nil);
+#ifndef RBTREE_NO_PARENT
+  assert(rbtree_parent(p) == t->nil);
+#endif
 #else
   assert(p->left == NULL);
   assert(p->right == NULL);
-  assert(p->parent == NULL);
+#ifndef RBTREE_NO_PARENT
+  assert(rbtree_parent(p) == NULL);
+#endif
 #endif
   delete_rbtree(t);
 }
@@ -243,12 +247,12 @@ static bool color_traverse(const node_t *p, const color_t parent_color,
     }
     return true;
   }
-  if (parent_color == RBTREE_RED && p->color == RBTREE_RED) {
+  if (parent_color == RBTREE_RED && rbtree_color(p) == RBTREE_RED) {
     return false;
   }
-  int next_depth = ((p->color == RBTREE_BLACK) ? 1 : 0) + black_depth;
-  return color_traverse(p->left, p->color, next_depth, nil) &&
-         color_traverse(p->right, p->color, next_depth, nil);
+  int next_depth = ((rbtree_color(p) == RBTREE_BLACK) ? 1 : 0) + black_depth;
+  return color_traverse(p->left, rbtree_color(p), next_depth, nil) &&
+         color_traverse(p->right, rbtree_color(p), next_depth, nil);
 }
 
 void test_color_constraint(const rbtree *t) {
@@ -259,7 +263,7 @@ void test_color_constraint(const rbtree *t) {
   node_t *nil = NULL;
 #endif
   node_t *p = t->root;
-  assert(p == nil || p->color == RBTREE_BLACK);
+  assert(p == nil || rbtree_color(p) == RBTREE_BLACK);
 
   init_color_traverse();
   assert(color_traverse(p, RBTREE_BLACK, 0, nil));
@@ -367,6 +371,1136 @@ void test_find_erase_rand(const size_t n, const unsigned int seed) {
   delete_rbtree(t);
 }
 
+#ifdef RBTREE_ORDER_STATS
+static size_t size_traverse(const node_t *p, const node_t *nil) {
+  if (p == nil) {
+    return 0;
+  }
+  const size_t size = size_traverse(p->left, nil) + size_traverse(p->right, nil) + rbtree_node_count(p);
+  assert(p->size == size);
+  return size;
+}
+#endif
+
+// erase should unlink the erased node only: every other node keeps its address and key
+void test_erase_keeps_nodes(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  node_t **nodes = calloc(n, sizeof(node_t *));
+  for (int i = 0; i < n; i++) {
+    arr[i] = i;
+  }
+  for (int i = n - 1; i > 0; i--) {
+    const int j = rand() % (i + 1);
+    const key_t tmp = arr[i];
+    arr[i] = arr[j];
+    arr[j] = tmp;
+  }
+  for (int i = 0; i < n; i++) {
+    nodes[i] = rbtree_insert(t, arr[i]);
+  }
+  // erase in insertion order: many of them have two children and a live successor
+  for (int i = 0; i < n; i++) {
+    assert(rbtree_find(t, arr[i]) == nodes[i]);
+    rbtree_erase(t, nodes[i]);
+    if (i % 97 == 0) {
+      for (int j = i + 1; j < n; j++) {
+        assert(nodes[j]->key == arr[j]);
+      }
+      test_search_constraint(t);
+      test_color_constraint(t);
+#ifdef RBTREE_ORDER_STATS
+      assert(size_traverse(t->root, t->nil) == n - 1 - i);
+#endif
+    }
+  }
+  assert(t->size == 0 && rbtree_min(t) == NULL);
+  free(nodes);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// shrink should release chunks left empty after mass erasure and keep the tree usable
+void test_shrink(const size_t n) {
+  rbtree *t = new_rbtree();
+  for (int i = 0; i < n; i++) {
+    assert(rbtree_insert(t, i) != NULL);
+  }
+  // keep only the last node alive
+  for (int i = 0; i < n - 1; i++) {
+    rbtree_erase(t, rbtree_find(t, i));
+  }
+  assert(rbtree_shrink(t) > 0);
+  assert(rbtree_shrink(t) == 0);
+
+  node_t *p = rbtree_find(t, n - 1);
+  assert(p != NULL);
+  assert(p->key == n - 1);
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  for (int i = 0; i < n; i++) {
+    assert(rbtree_insert(t, i) != NULL);
+  }
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  delete_rbtree(t);
+}
+
+// building from a sorted array should give a valid rbtree that converts back to the same array
+void test_from_sorted_array(const size_t max_n) {
+  key_t *arr = calloc(max_n, sizeof(key_t));
+  key_t *res = calloc(max_n, sizeof(key_t));
+  for (size_t n = 0; n < max_n; n++) {
+    for (int i = 0; i < n; i++) {
+      arr[i] = i / 3;  // with duplicates
+    }
+    rbtree *t = rbtree_from_sorted_array(arr, n);
+    assert(t != NULL);
+    test_color_constraint(t);
+    test_search_constraint(t);
+    rbtree_to_array(t, res, n);
+    for (int i = 0; i < n; i++) {
+      assert(arr[i] == res[i]);
+    }
+    if (n > 0) {
+      assert(rbtree_min(t)->key == arr[0]);
+      assert(rbtree_max(t)->key == arr[n - 1]);
+      rbtree_erase(t, rbtree_find(t, arr[n / 2]));
+      rbtree_insert(t, arr[n / 2]);
+      test_color_constraint(t);
+      test_search_constraint(t);
+    }
+    delete_rbtree(t);
+  }
+  free(res);
+  free(arr);
+}
+
+// batch insert should keep existing nodes in place and give the same result as single inserts
+void test_insert_batch(const size_t n, const size_t batch, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n + batch, sizeof(key_t));
+  for (int i = 0; i < n + batch; i++) {
+    arr[i] = rand() % (n + batch);
+  }
+  assert(rbtree_insert_batch(t, arr, n) == n);
+  node_t *p = rbtree_find(t, arr[0]);
+  assert(p != NULL);
+  const key_t key = p->key;
+
+  assert(rbtree_insert_batch(t, arr + n, batch) == batch);
+  assert(p->key == key);
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  qsort((void *)arr, n + batch, sizeof(key_t), comp);
+  key_t *res = calloc(n + batch, sizeof(key_t));
+  rbtree_to_array(t, res, n + batch);
+  for (int i = 0; i < n + batch; i++) {
+    assert(arr[i] == res[i]);
+  }
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// next/prev should walk the tree in key order and bounds should match the sorted array
+void test_iterator(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++) {
+    arr[i] = 2 * (rand() % (n / 2));  // even keys with duplicates
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  node_t *p = rbtree_min(t);
+  for (int i = 0; i < n; i++) {
+    assert(p != NULL);
+    assert(p->key == arr[i]);
+    p = rbtree_next(t, p);
+  }
+  assert(p == NULL);
+
+  p = rbtree_max(t);
+  for (int i = n - 1; i >= 0; i--) {
+    assert(p != NULL);
+    assert(p->key == arr[i]);
+    p = rbtree_prev(t, p);
+  }
+  assert(p == NULL);
+
+  for (key_t key = -1; key <= n + 1; key++) {
+    int lower = 0, upper;
+    while (lower < n && arr[lower] < key) {
+      lower++;
+    }
+    upper = lower;
+    while (upper < n && arr[upper] <= key) {
+      upper++;
+    }
+
+    node_t *lb = rbtree_lower_bound(t, key);
+    node_t *ub = rbtree_upper_bound(t, key);
+    node_t *fl = rbtree_floor(t, key);
+    node_t *ce = rbtree_ceil(t, key);
+    assert(lower == n ? lb == NULL : lb != NULL && lb->key == arr[lower]);
+    assert(upper == n ? ub == NULL : ub != NULL && ub->key == arr[upper]);
+    assert(upper == 0 ? fl == NULL : fl != NULL && fl->key == arr[upper - 1]);
+    assert(ce == lb);
+    // lower_bound should be the first of the equal keys and floor the last
+    assert(lb == NULL || rbtree_prev(t, lb) == NULL || rbtree_prev(t, lb)->key < key);
+    assert(fl == NULL || rbtree_next(t, fl) == ub);
+
+    node_t *first, *end;
+    rbtree_equal_range(t, key, &first, &end);
+    int count = 0;
+    for (p = first; p != end; p = rbtree_next(t, p)) {
+      assert(p->key == key);
+      count++;
+    }
+    assert(count == upper - lower);
+  }
+
+  free(arr);
+  delete_rbtree(t);
+}
+
+// hinted inserts (sequential, reverse, random hints) should keep a valid tree with the same contents
+void test_insert_hint(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(3 * n, sizeof(key_t));
+  size_t m = 0;
+
+  // ascending with the previous node as hint, then descending in front of the minimum
+  node_t *hint = NULL;
+  for (int i = 0; i < n; i++) {
+    hint = rbtree_insert_hint(t, hint, i);
+    assert(hint != NULL && hint->key == i);
+    arr[m++] = i;
+  }
+  assert(t->rightmost == hint);
+  hint = rbtree_min(t);
+  for (int i = -1; i >= -(int)n; i--) {
+    hint = rbtree_insert_hint(t, hint, i);
+    assert(hint->key == i);
+    arr[m++] = i;
+  }
+
+  // random keys with random (often wrong) hints fall back to a normal insert
+  for (int i = 0; i < n; i++) {
+    node_t *some = rbtree_find(t, arr[rand() % m]);
+    const key_t key = rand() % (2 * n) - n;
+    assert(rbtree_insert_hint(t, some, key)->key == key);
+    arr[m++] = key;
+  }
+  assert(t->size == m);
+  test_search_constraint(t);
+  test_color_constraint(t);
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  key_t *res = calloc(m, sizeof(key_t));
+  assert(rbtree_to_array(t, res, m) == m);
+  for (int i = 0; i < m; i++) {
+    assert(res[i] == arr[i]);
+  }
+  free(res);
+
+  free(arr);
+  delete_rbtree(t);
+}
+
+// cached min/max should match a walk down the spine after every kind of insert and erase
+static void check_extremes(const rbtree *t) {
+  if (t->root == t->nil) {
+    assert(rbtree_min(t) == NULL && rbtree_max(t) == NULL);
+    return;
+  }
+  node_t *lo = t->root, *hi = t->root;
+  while (lo->left != t->nil) {
+    lo = lo->left;
+  }
+  while (hi->right != t->nil) {
+    hi = hi->right;
+  }
+  assert(rbtree_min(t) == lo && rbtree_max(t) == hi);
+}
+
+void test_minmax_cached(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  check_extremes(t);
+  for (int round = 0; round < 3; round++) {
+    node_t *hint = NULL;
+    for (int i = 0; i < n; i++) {
+      const key_t key = rand() % n - n / 2;
+      if (rand() % 2) {
+        rbtree_insert(t, key);
+      } else {
+        hint = rbtree_insert_hint(t, hint, key);
+      }
+      check_extremes(t);
+    }
+    const key_t batch[] = {-(key_t)n, 0, (key_t)n};
+    rbtree_insert_batch(t, batch, 3);
+    check_extremes(t);
+    while (t->size > n / 2) {
+      const int pick = rand() % 3;
+      rbtree_erase(t, pick == 0 ? t->root : pick == 1 ? rbtree_min(t) : rbtree_max(t));
+      check_extremes(t);
+    }
+  }
+  while (t->root != t->nil) {
+    rbtree_erase(t, t->root);
+    check_extremes(t);
+  }
+  delete_rbtree(t);
+
+  const key_t sorted[] = {1, 2, 3};
+  t = rbtree_from_sorted_array(sorted, 3);
+  assert(rbtree_min(t)->key == 1 && rbtree_max(t)->key == 3);
+  check_extremes(t);
+  delete_rbtree(t);
+}
+
+// to_array should stop at n and paged export should resume right after the last key
+void test_to_array_page(const size_t n, const size_t page, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++) {
+    arr[i] = rand() % (n / 4);  // many duplicates
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  res[n / 2] = -1;
+  assert(rbtree_to_array(t, res, n / 2) == n / 2);
+  assert(res[n / 2] == -1);
+  for (int i = 0; i < n / 2; i++) {
+    assert(arr[i] == res[i]);
+  }
+
+  rbtree_cursor cursor = {0};
+  size_t total = 0;
+  while (!cursor.done) {
+    const size_t written = rbtree_to_array_page(t, res + total, page, &cursor);
+    assert(written <= page);
+    total += written;
+  }
+  assert(total == n);
+  for (int i = 0; i < n; i++) {
+    assert(arr[i] == res[i]);
+  }
+  assert(rbtree_to_array_page(t, res, page, &cursor) == 0);
+
+  // erasing keys already exported should not shift the next page
+  rbtree_cursor c = {0};
+  assert(rbtree_to_array_page(t, res, page, &c) == page);
+  for (int i = 0; i < page; i++) {
+    rbtree_erase(t, rbtree_find(t, res[i]));
+  }
+  assert(rbtree_to_array_page(t, res, page, &c) == page);
+  for (int i = 0; i < page; i++) {
+    assert(arr[page + i] == res[i]);
+  }
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+#ifdef RBTREE_ORDER_STATS
+// select/rank/count_range should agree with the sorted array while inserting and erasing
+void test_order_statistics(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++) {
+    arr[i] = rand() % (n / 2);  // with duplicates
+  }
+  insert_arr(t, arr, n);
+  // erase every other key inserted
+  for (int i = 0; i < n; i += 2) {
+    rbtree_erase(t, rbtree_find(t, arr[i]));
+  }
+  for (int i = 0; i < n / 2; i++) {
+    arr[i] = arr[2 * i + 1];
+  }
+  const size_t m = n / 2;
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  assert(size_traverse(t->root, t->nil) == m);
+
+  for (int k = 0; k < m; k++) {
+    node_t *p = rbtree_select(t, k);
+    assert(p != NULL);
+    assert(p->key == arr[k]);
+  }
+  assert(rbtree_select(t, m) == NULL);
+
+  for (key_t key = -1; key <= n / 2; key++) {
+    size_t less = 0, not_greater = 0;
+    while (less < m && arr[less] < key) {
+      less++;
+    }
+    not_greater = less;
+    while (not_greater < m && arr[not_greater] <= key) {
+      not_greater++;
+    }
+    assert(rbtree_rank(t, key) == less);
+    assert(rbtree_count_range(t, key, key) == not_greater - less);
+    assert(rbtree_count_range(t, key, n) == m - less);
+  }
+  assert(rbtree_count_range(t, 1, 0) == 0);
+
+  free(arr);
+  delete_rbtree(t);
+}
+#endif
+
+// every child should point back to its parent (nothing to check without parent pointers)
+static void parent_traverse(const node_t *p, const node_t *nil) {
+#ifdef RBTREE_NO_PARENT
+  (void)p;
+  (void)nil;
+#else
+  if (p == nil) {
+    return;
+  }
+  assert(p->left == nil || rbtree_parent(p->left) == p);
+  assert(p->right == nil || rbtree_parent(p->right) == p);
+  parent_traverse(p->left, nil);
+  parent_traverse(p->right, nil);
+#endif
+}
+
+// pop_min/pop_max return keys in order; update_key moves a node without changing its address
+void test_priority_queue(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  node_t **nodes = calloc(n, sizeof(node_t *));
+  key_t *arr = calloc(n, sizeof(key_t));
+  key_t key;
+  assert(!rbtree_pop_min(t, &key) && !rbtree_pop_max(t, &key));
+
+  for (int i = 0; i < n; i++) {
+    nodes[i] = rbtree_insert(t, rand() % n);
+  }
+  // move every node several times: some stay between their neighbours, most are relinked
+  for (int round = 0; round < 4; round++) {
+    for (int i = 0; i < n; i++) {
+      node_t *p = nodes[rand() % n];
+      const key_t moved = round % 2 ? p->key + rand() % 3 - 1 : rand() % n;
+      assert(rbtree_update_key(t, p, moved) == p);
+      assert(p->key == moved);
+    }
+    assert(t->size == n);
+    test_search_constraint(t);
+    test_color_constraint(t);
+    parent_traverse(t->root, t->nil);
+#ifdef RBTREE_ORDER_STATS
+    assert(size_traverse(t->root, t->nil) == n);
+#endif
+  }
+  for (int i = 0; i < n; i++) {
+    arr[i] = nodes[i]->key;
+  }
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  // alternate between both ends
+  size_t lo = 0, hi = n;
+  while (lo < hi) {
+    if ((lo + hi) % 2) {
+      assert(rbtree_pop_min(t, &key) && key == arr[lo++]);
+    } else {
+      assert(rbtree_pop_max(t, &key) && key == arr[--hi]);
+    }
+    assert(t->size == hi - lo);
+    if (t->size % 64 == 0) {
+      test_search_constraint(t);
+      test_color_constraint(t);
+    }
+  }
+  assert(!rbtree_pop_min(t, &key) && rbtree_min(t) == NULL && t->root == t->nil);
+
+  free(arr);
+  free(nodes);
+  delete_rbtree(t);
+}
+
+static void check_key_order(const key_t key, void *ctx) {
+  key_t *last = (key_t *)ctx;
+  assert(last[1] == 0 || last[0] <= key);  // keys arrive in order
+  last[0] = key;
+  last[1]++;
+}
+
+// erase small and large ranges (both code paths) and compare against a sorted array
+void test_erase_range(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  size_t len = n;
+  for (int i = 0; i < n; i++) {
+    arr[i] = rand() % n;
+    rbtree_insert(t, arr[i]);
+  }
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  assert(rbtree_erase_range(t, 5, 4) == 0);
+  assert(rbtree_erase_range(t, n, n + 10) == 0);
+
+  while (len > 0) {
+    const key_t lo = rand() % n;
+    const key_t hi = lo + (rand() % 4 == 0 ? rand() % n : rand() % 16);
+    size_t expected = 0, j = 0;
+    for (size_t i = 0; i < len; i++) {
+      if (lo <= arr[i] && arr[i] <= hi) {
+        expected++;
+      } else {
+        arr[j++] = arr[i];
+      }
+    }
+    key_t seen[2] = {0, 0};
+    assert(rbtree_erase_range_fn(t, lo, hi, check_key_order, seen) == expected);
+    assert(seen[1] == expected);
+    len = j;
+
+    assert(t->size == len);
+    test_search_constraint(t);
+    test_color_constraint(t);
+    parent_traverse(t->root, t->nil);
+    check_extremes(t);
+#ifdef RBTREE_ORDER_STATS
+    assert(size_traverse(t->root, t->nil) == len);
+#endif
+    key_t *res = calloc(len + 1, sizeof(key_t));
+    rbtree_to_array(t, res, len);
+    for (size_t i = 0; i < len; i++) {
+      assert(res[i] == arr[i]);
+    }
+    free(res);
+    if (len < n / 8) {
+      assert(rbtree_erase_range(t, 0, n) == len);
+      len = 0;
+    }
+  }
+  assert(t->root == t->nil && rbtree_min(t) == NULL && rbtree_max(t) == NULL);
+
+  // the tree is still usable afterwards
+  rbtree_insert(t, 7);
+  assert(rbtree_min(t)->key == 7 && t->size == 1);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// check a tree produced by split/join against the sorted keys it should hold
+static void check_tree_keys(const rbtree *t, const key_t *arr, const size_t n) {
+  assert(t->size == n);
+  test_search_constraint(t);
+  test_color_constraint(t);
+  parent_traverse(t->root, t->nil);
+  check_extremes(t);
+#ifdef RBTREE_ORDER_STATS
+  assert(size_traverse(t->root, t->nil) == n);
+#endif
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(rbtree_to_array(t, res, n) == n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == arr[i]);
+  }
+  free(res);
+}
+
+#ifdef RBTREE_ORDER_STATS
+// split at random keys, keep using the parts, then join everything back
+void test_split_join(const size_t n, const unsigned int seed) {
+  srand(seed);
+  const size_t parts = 8;
+  key_t *arr = calloc(n + parts, sizeof(key_t));
+  rbtree *t = new_rbtree();
+  for (int i = 0; i < n; i++) {
+    arr[i] = rand() % (n / 4);
+    rbtree_insert(t, arr[i]);
+  }
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  // split at every position class: below the minimum, on duplicates, above the maximum
+  const key_t cuts[] = {-1, arr[0], arr[n / 3], arr[n / 2] + 1, arr[n - 1], arr[n - 1] + 1};
+  for (int i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+    rbtree *left, *right;
+    assert(rbtree_split(t, cuts[i], &left, &right) == 0);
+    assert(left == t);
+    size_t m = 0;
+    while (m < n && arr[m] < cuts[i]) {
+      m++;
+    }
+    check_tree_keys(left, arr, m);
+    check_tree_keys(right, arr + m, n - m);
+    // out of order joins are refused and leave both trees alone
+    if (m > 0 && m < n) {
+      assert(rbtree_join(right, left) == NULL);
+      assert(rbtree_join_key(left, arr[n - 1] + 1, right) == NULL);
+    }
+    t = rbtree_join(left, right);
+    assert(t == left);
+    check_tree_keys(t, arr, n);
+  }
+
+  // split into several parts with distinct boundaries and modify each part on its own
+  rbtree *part[8];
+  key_t bound[8];
+  part[0] = t;
+  for (int i = 1; i < parts; i++) {
+    bound[i] = (key_t)(i * (n / 4) / parts);
+    assert(rbtree_split(part[i - 1], bound[i], &part[i - 1], &part[i]) == 0);
+  }
+  for (int i = 0; i < parts; i++) {
+    const key_t lo = i == 0 ? 0 : bound[i];
+    rbtree_insert(part[i], lo);
+    node_t *p = rbtree_find(part[i], lo);
+    assert(p != NULL);
+    rbtree_erase(part[i], p);
+  }
+  // join back alternating between plain joins and joins through a pivot key
+  size_t total = n;
+  for (int i = parts - 1; i > 0; i--) {
+    if (i % 2) {
+      assert(rbtree_join(part[i - 1], part[i]) == part[i - 1]);
+    } else {
+      assert(rbtree_join_key(part[i - 1], bound[i], part[i]) == part[i - 1]);
+      arr[total++] = bound[i];
+    }
+  }
+  t = part[0];
+  qsort((void *)arr, total, sizeof(key_t), comp);
+  check_tree_keys(t, arr, total);
+
+  // the joined tree is an ordinary tree: erase everything and reuse it
+  for (size_t i = 0; i < total; i++) {
+    node_t *p = rbtree_find(t, arr[i]);
+    assert(p != NULL);
+    rbtree_erase(t, p);
+  }
+  assert(t->size == 0 && t->root == t->nil);
+  rbtree_insert(t, 3);
+  check_extremes(t);
+
+  // parts can be deleted separately in any order
+  rbtree *left, *right;
+  assert(rbtree_split(t, 2, &left, &right) == 0);
+  assert(left->size == 0 && right->size == 1);
+  delete_rbtree(right);
+  delete_rbtree(left);
+
+  free(arr);
+}
+
+// chunks shared after a split go back to the tree once it is their only user, and shrink can release them
+void test_shrink_after_split(const size_t n) {
+  rbtree *t = new_rbtree(), *left, *right;
+  for (int i = 0; i < n; i++) {
+    rbtree_insert(t, i);
+  }
+  // joined back together
+  assert(rbtree_split(t, n / 2, &left, &right) == 0);
+  assert(rbtree_join(left, right) == left);
+  for (int i = 0; i < n - 1; i++) {
+    rbtree_erase(left, rbtree_find(left, i));
+  }
+  assert(rbtree_shrink(left) > 0);
+  assert(rbtree_shrink(left) == 0);
+  assert(left->size == 1 && rbtree_min(left)->key == n - 1);
+
+  // the other part deleted, including the nodes it still held
+  for (int i = 0; i < n; i++) {
+    rbtree_insert(left, i);
+  }
+  assert(rbtree_split(left, n / 4, &left, &right) == 0);
+  assert(rbtree_shrink(left) == 0);
+  delete_rbtree(right);
+  while (left->size > 1) {
+    rbtree_erase(left, rbtree_min(left));
+  }
+  assert(rbtree_shrink(left) > 0);
+  for (int i = 0; i < n; i++) {
+    rbtree_insert(left, i);
+  }
+  test_color_constraint(left);
+  test_search_constraint(left);
+  assert(left->size == n + 1);
+  delete_rbtree(left);
+}
+#endif
+
+// join trees built separately over adjacent key ranges (split needs RBTREE_ORDER_STATS, join does not)
+void test_join(const size_t n, const unsigned int seed) {
+  srand(seed);
+  key_t *arr = calloc(4 * n + 8, sizeof(key_t));
+  rbtree *part[3];
+  size_t total = 0;
+  // uneven sizes so the joins hang a short tree off a tall one's spine; part 1 shares its edge keys
+  const size_t sizes[3] = {n, n / 50 + 1, 2 * n};
+  for (int i = 0; i < 3; i++) {
+    part[i] = new_rbtree();
+    for (size_t j = 0; j < sizes[i]; j++) {
+      const key_t key = (key_t)(i * n + rand() % n);
+      rbtree_insert(part[i], key);
+      arr[total++] = key;
+    }
+  }
+  rbtree_insert(part[1], (key_t)n);
+  rbtree_insert(part[1], (key_t)(2 * n));
+  arr[total++] = (key_t)n;
+  arr[total++] = (key_t)(2 * n);
+
+  // out of order joins are refused and leave both trees alone
+  assert(rbtree_join(part[1], part[0]) == NULL);
+  assert(rbtree_join_key(part[0], (key_t)(2 * n + 1), part[1]) == NULL);
+  assert(part[0]->size == sizes[0] && part[1]->size == sizes[1] + 2);
+
+  assert(rbtree_join_key(part[1], (key_t)(2 * n), part[2]) == part[1]);
+  arr[total++] = (key_t)(2 * n);
+  assert(rbtree_join(part[0], part[1]) == part[0]);
+  qsort((void *)arr, total, sizeof(key_t), comp);
+  check_tree_keys(part[0], arr, total);
+
+  // joining with an empty tree keeps the other one as is
+  rbtree *empty = new_rbtree();
+  assert(rbtree_join(part[0], empty) == part[0]);
+  check_tree_keys(part[0], arr, total);
+  empty = new_rbtree();
+  assert(rbtree_join(empty, part[0]) == empty);
+  check_tree_keys(empty, arr, total);
+  delete_rbtree(empty);
+  free(arr);
+}
+
+#ifndef RBTREE_COUNTED
+// with many equal keys, every node handle stays usable after joins and a union bring equal keys from several trees
+// together, after many moves (the no-parent build numbers equal keys and renumbers them when the numbers run out)
+void test_node_handles(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *left = new_rbtree(), *right = new_rbtree(), *tail = new_rbtree(), *small = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(left, rand() % 5);
+    rbtree_insert(right, 4 + rand() % 4);
+  }
+  for (size_t i = 0; i < n / 20; i++) {
+    rbtree_insert(tail, 7 + rand() % 2);
+    rbtree_insert(small, rand() % 9);
+  }
+  rbtree *t = rbtree_join_key(left, 4, right);
+  assert(t == left);
+  assert(rbtree_join(t, tail) == t);
+  assert(rbtree_union(t, small) == t);
+  const size_t total = t->size;
+  assert(total == 2 * n + 2 * (n / 20) + 1);
+
+  node_t **nodes = calloc(total, sizeof(node_t *));
+  size_t m = 0;
+  for (node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)) {
+    nodes[m++] = p;
+  }
+  assert(m == total);
+  for (int round = 0; round < 96; round++) {
+    for (size_t i = 0; i < total; i++) {
+      node_t *p = nodes[rand() % total];
+      const key_t key = rand() % 9;
+      assert(rbtree_update_key(t, p, key) == p && p->key == key);
+    }
+  }
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  // erase every node through its handle in random order
+  for (size_t i = total; i > 1; i--) {
+    const size_t j = rand() % i;
+    node_t *p = nodes[j];
+    nodes[j] = nodes[i - 1];
+    nodes[i - 1] = p;
+  }
+  for (size_t i = 0; i < total; i++) {
+    rbtree_erase(t, nodes[i]);
+    assert(t->size == total - i - 1);
+    if (i % 512 == 0) {
+      test_color_constraint(t);
+      test_search_constraint(t);
+    }
+  }
+  assert(rbtree_min(t) == NULL);
+  free(nodes);
+  delete_rbtree(t);
+}
+#endif
+
+// equal keys from both sides of a join-based union stay reachable in a copy, whose nodes sit at other addresses
+void test_union_copy(const size_t n, const size_t m) {
+  rbtree *a = new_rbtree(), *b = new_rbtree();
+  key_t *arr = calloc(n + m, sizeof(key_t));
+  for (size_t i = 0; i < n + m; i++) {
+    arr[i] = 5;
+    rbtree_insert(i < n ? a : b, 5);
+  }
+  assert(rbtree_union(a, b) == a);
+  rbtree *c = rbtree_copy(a);
+  check_tree_keys(a, arr, n + m);
+  check_tree_keys(c, arr, n + m);
+  size_t walked = 0;
+  for (node_t *p = rbtree_min(c); p != NULL; p = rbtree_next(c, p)) {
+    walked += rbtree_node_count(p);
+  }
+  assert(walked == n + m);
+  // every node can be found again from its handle
+  rbtree_insert(c, 4);
+  rbtree_insert(c, 6);
+  for (node_t *p; (p = rbtree_find(c, 5)) != NULL;) {
+    rbtree_erase(c, p);
+  }
+  assert(c->size == 2 && rbtree_min(c)->key == 4 && rbtree_max(c)->key == 6);
+  free(arr);
+  delete_rbtree(c);
+  delete_rbtree(a);
+}
+
+// expected multiset result of merging two sorted arrays; op: 0 union, 1 intersection, 2 difference
+static size_t merge_expected(const key_t *a, const size_t n, const key_t *b, const size_t m, const int op, key_t *out) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < n || j < m) {
+    const key_t key = (j == m || (i < n && a[i] <= b[j])) ? a[i] : b[j];
+    size_t ca = 0, cb = 0;
+    while (i < n && a[i] == key) {
+      i++, ca++;
+    }
+    while (j < m && b[j] == key) {
+      j++, cb++;
+    }
+    size_t c = op == 0 ? ca + cb : op == 1 ? (ca < cb ? ca : cb) : (ca > cb ? ca - cb : 0);
+    while (c-- > 0) {
+      out[k++] = key;
+    }
+  }
+  return k;
+}
+
+static rbtree *tree_of(const key_t *arr, const size_t n) {
+  rbtree *t = new_rbtree();
+  insert_arr(t, arr, n);
+  return t;
+}
+
+// union/intersection/difference on copies should match a merge of the sorted inputs
+void test_set_operations(const size_t n, const unsigned int seed) {
+  srand(seed);
+  // small right sides take the join-based path, similar sizes the linear merge
+  const size_t sizes[] = {0, 1, 7, n / 40, n / 10, n};
+  key_t *a = calloc(n, sizeof(key_t));
+  key_t *b = calloc(n, sizeof(key_t));
+  key_t *expected = calloc(2 * n + 1, sizeof(key_t));
+  for (int i = 0; i < n; i++) {
+    a[i] = rand() % (n / 2);
+  }
+  qsort((void *)a, n, sizeof(key_t), comp);
+  rbtree *ta = tree_of(a, n);
+
+  for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    const size_t m = sizes[s];
+    for (int i = 0; i < m; i++) {
+      b[i] = rand() % (n / 2);
+    }
+    qsort((void *)b, m, sizeof(key_t), comp);
+    rbtree *tb = tree_of(b, m);
+    for (int op = 0; op < 3; op++) {
+      rbtree *x = rbtree_copy(ta);
+      rbtree *y = rbtree_copy(tb);
+      check_tree_keys(x, a, n);
+      rbtree *r = op == 0 ? rbtree_union(x, y) : op == 1 ? rbtree_intersection(x, y) : rbtree_difference(x, y);
+      assert(r == x);
+      check_tree_keys(r, expected, merge_expected(a, n, b, m, op, expected));
+      // the result is an ordinary tree
+      rbtree_insert(r, -1);
+      assert(rbtree_min(r)->key == -1);
+      delete_rbtree(r);
+
+      // the smaller tree on the left as well
+      x = rbtree_copy(tb);
+      y = rbtree_copy(ta);
+      r = op == 0 ? rbtree_union(x, y) : op == 1 ? rbtree_intersection(x, y) : rbtree_difference(x, y);
+      check_tree_keys(r, expected, merge_expected(b, m, a, n, op, expected));
+      delete_rbtree(r);
+    }
+    // inputs of the copies are untouched
+    check_tree_keys(tb, b, m);
+    delete_rbtree(tb);
+  }
+  check_tree_keys(ta, a, n);
+
+  delete_rbtree(ta);
+  free(expected);
+  free(b);
+  free(a);
+}
+
+// insert_unique should return the existing node for a repeated key and never grow the tree
+void test_insert_unique(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  node_t **nodes = calloc(n, sizeof(node_t *));
+  for (int i = 0; i < n; i++) {
+    nodes[i] = rbtree_insert_unique(t, i);
+    assert(nodes[i] != NULL && nodes[i]->key == i);
+  }
+  for (int i = 0; i < n; i++) {
+    const key_t key = rand() % n;
+    assert(rbtree_insert_unique(t, key) == nodes[key]);
+  }
+  assert(t->size == n);
+  size_t walked = 0;
+  for (node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)) {
+    walked++;
+  }
+  assert(walked == n);
+  test_search_constraint(t);
+  test_color_constraint(t);
+  free(nodes);
+  delete_rbtree(t);
+}
+
+// find_batch should give exactly what rbtree_find gives for each key, including misses and duplicates
+void test_find_batch(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t one = 0;
+  node_t *none = t->nil;
+  assert(rbtree_find_batch(t, &one, 1, &none) == 0 && none == NULL);
+  for (int i = 0; i < n; i++) {
+    rbtree_insert(t, rand() % (int)n);
+  }
+  // batch sizes below, at and above the interleaving width, and not a multiple of it
+  const size_t sizes[] = {0, 1, 5, 16, 17, 3 * n};
+  key_t *keys = calloc(3 * n, sizeof(key_t));
+  node_t **out = calloc(3 * n, sizeof(node_t *));
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t expected = 0;
+    for (size_t i = 0; i < sizes[s]; i++) {
+      keys[i] = rand() % (int)(2 * n) - (int)(n / 2);
+      out[i] = t->nil;
+      expected += rbtree_find(t, keys[i]) != NULL;
+    }
+    assert(rbtree_find_batch(t, keys, sizes[s], out) == expected);
+    for (size_t i = 0; i < sizes[s]; i++) {
+      assert(out[i] == rbtree_find(t, keys[i]));
+    }
+  }
+  free(out);
+  free(keys);
+  delete_rbtree(t);
+}
+
+#ifdef RBTREE_COUNTED
+static size_t distinct_keys(const key_t *arr, const size_t n) {
+  size_t distinct = 0;
+  for (int i = 0; i < n; i++) {
+    distinct += i == 0 || arr[i] != arr[i - 1];
+  }
+  return distinct;
+}
+
+static size_t node_count(rbtree *t) {
+  size_t nodes = 0;
+  for (node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)) {
+    nodes++;
+  }
+  return nodes;
+}
+
+// repeated keys should share one node whose count follows every insert and erase path
+void test_counted(const size_t n, const unsigned int seed) {
+  srand(seed);
+  const size_t range = n / 20;
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+    node_t *p = rbtree_insert(t, arr[i]);
+    assert(p == rbtree_find(t, arr[i]));
+  }
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  const size_t distinct = distinct_keys(arr, n);
+  assert(t->size == n && node_count(t) == distinct);
+  check_tree_keys(t, arr, n);
+  // insert_unique leaves the count alone
+  node_t *p = rbtree_find(t, arr[0]);
+  const size_t count = p->count;
+  assert(rbtree_insert_unique(t, arr[0]) == p && p->count == count && t->size == n);
+  test_search_constraint(t);
+  test_color_constraint(t);
+#ifdef RBTREE_ORDER_STATS
+  assert(size_traverse(t->root, t->nil) == n);
+  for (int i = 0; i < n; i += 7) {
+    assert(rbtree_select(t, i)->key == arr[i]);
+    assert(rbtree_rank(t, arr[i]) <= i && i < rbtree_rank(t, arr[i]) + rbtree_select(t, i)->count);
+  }
+  assert(rbtree_count_range(t, 0, range) == n);
+#endif
+
+  // pages split in the middle of a count
+  key_t *res = calloc(n, sizeof(key_t));
+  rbtree_cursor cursor = {0};
+  size_t got = 0, page;
+  while ((page = rbtree_to_array_page(t, res + got, 3, &cursor)) > 0) {
+    got += page;
+  }
+  assert(got == n);
+  for (int i = 0; i < n; i++) {
+    assert(res[i] == arr[i]);
+  }
+
+  // hint and batch inserts bump the existing nodes as well
+  rbtree_insert_hint(t, rbtree_min(t), arr[0]);
+  rbtree_insert_hint(t, rbtree_max(t), arr[n - 1] + 1);
+  assert(t->size == n + 2 && node_count(t) == distinct + 1);
+  assert(rbtree_insert_batch(t, arr, n) == n);
+  assert(t->size == 2 * n + 2 && node_count(t) == distinct + 1);
+  rbtree *copy = rbtree_from_sorted_array(arr, n);
+  assert(copy->size == n && node_count(copy) == distinct);
+  check_tree_keys(copy, arr, n);
+
+  // erase drops one copy at a time, the node goes with the last one
+  key_t key;
+  assert(rbtree_pop_max(t, &key) && key == arr[n - 1] + 1);
+  p = rbtree_find(t, arr[0]);
+  for (size_t left = p->count; left > 1; left--) {
+    rbtree_erase(t, p);
+    assert(rbtree_find(t, arr[0]) == p && p->count == left - 1);
+  }
+  rbtree_erase(t, p);
+  assert(rbtree_find(t, arr[0]) == NULL);
+  p = rbtree_min(t);
+  const size_t min_count = p->count;
+  assert(rbtree_pop_min(t, &key) && key == p->key);
+  assert(min_count > 1 ? rbtree_min(t) == p && p->count == min_count - 1 : rbtree_find(t, key) == NULL);
+
+  // moving one copy leaves the rest behind and joins the copy to an existing node
+  p = rbtree_max(t);
+  const size_t max_count = p->count;
+  node_t *moved = rbtree_update_key(t, p, rbtree_min(t)->key);
+  assert(moved == rbtree_min(t) && rbtree_max(t) == p && p->count == max_count - 1);
+  // a copy moved to a key not yet in the tree gets its own node, and the total stays the same
+  const key_t fresh = rbtree_max(t)->key + 1;
+  rbtree_insert(t, fresh);
+  p = rbtree_insert(t, fresh);
+  const size_t before = t->size;
+  moved = rbtree_update_key(t, p, fresh + 1);
+  assert(moved != NULL && moved != p && moved->key == fresh + 1 && moved->count == 1);
+  assert(p->count == 1 && rbtree_max(t) == moved && t->size == before);
+#ifdef RBTREE_ORDER_STATS
+  assert(size_traverse(t->root, t->nil) == t->size);
+#endif
+  test_search_constraint(t);
+  test_color_constraint(t);
+
+  // set operations add and subtract counts
+  const size_t size = copy->size;
+  rbtree *r = rbtree_union(copy, rbtree_copy(copy));
+  assert(r->size == 2 * size && node_count(r) == distinct);
+  r = rbtree_difference(r, rbtree_from_sorted_array(arr, n));
+  check_tree_keys(r, arr, n);
+  delete_rbtree(r);
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+#endif
+
+#ifdef RBTREE_STATS
+// counters should follow the textbook cases on a small tree and stay consistent on a large one
+void test_stats(const size_t n) {
+  rbtree *t = new_rbtree();
+  rbtree_stats stats = rbtree_get_stats(t);
+  assert(stats.comparisons == 0 && stats.nodes_allocated == 0);
+
+  // 1, 2, 3 in order: the third insert is a straight-line case 3 with one left rotation
+  rbtree_insert(t, 1);
+  rbtree_insert(t, 2);
+  rbtree_insert(t, 3);
+  stats = rbtree_get_stats(t);
+  // ascending keys take the append-at-max path: one comparison each
+  assert(stats.comparisons == 0 + 1 + 1);
+  assert(stats.rotations_left == 1 && stats.rotations_right == 0);
+  assert(stats.insert_fixup_cases[0] == 0 && stats.insert_fixup_cases[1] == 0 && stats.insert_fixup_cases[2] == 1);
+  assert(stats.insert_fixup_calls == 3 && stats.insert_fixup_depth_max == 1);
+  assert(stats.nodes_allocated == 3 && stats.nodes_freed == 0);
+  rbtree_find(t, 3);
+  assert(rbtree_get_stats(t).comparisons == 2 + 2);
+
+  // 4 has a red uncle: case 1 recolors and recurses once to the root
+  rbtree_insert(t, 4);
+  stats = rbtree_get_stats(t);
+  assert(stats.insert_fixup_cases[0] == 1 && stats.insert_fixup_depth_max == 2);
+
+  rbtree_reset_stats(t);
+  stats = rbtree_get_stats(t);
+  assert(stats.comparisons == 0 && stats.insert_fixup_calls == 0 && stats.rotations_left == 0);
+
+  for (int i = 0; i < n; i++) {
+    rbtree_insert(t, rand() % n);
+  }
+  while (t->size > n / 2) {
+    rbtree_erase(t, t->root);
+  }
+  stats = rbtree_get_stats(t);
+  assert(stats.nodes_allocated == n && stats.nodes_freed == n + 4 - t->size);
+  uint64_t cases = 0;
+  for (int i = 0; i < 4; i++) {
+    cases += stats.erase_fixup_cases[i];
+  }
+  assert(cases > 0 && cases <= stats.erase_fixup_calls);
+  // fixup recursion never goes deeper than the tree height
+  size_t height = 0;
+  for (size_t m = n + 4; m > 0; m >>= 1) {
+    height += 2;
+  }
+  assert(stats.insert_fixup_depth_max >= 2 && stats.insert_fixup_depth_max <= height);
+  assert(stats.erase_fixup_depth_max >= 1 && stats.erase_fixup_depth_max <= height);
+  delete_rbtree(t);
+}
+#endif
+
+#ifdef RBTREE_STATS
+// cutting out a range costs O(log n) rebalancing however many keys it removes: no erase fixups,
+// and the joins' insert fixups and rotations are bounded by the tree height, not by k
+void test_erase_range_cost(const size_t n) {
+  rbtree *t = new_rbtree();
+  for (int i = 0; i < n; i++) {
+    rbtree_insert(t, rand() % n);
+  }
+  size_t height = 0;
+  for (size_t m = n; m > 0; m >>= 1) {
+    height += 2;
+  }
+  for (size_t k = 16; k <= n / 2; k *= 8) {
+    rbtree_reset_stats(t);
+    const key_t lo = (key_t)(n / 4);
+    const size_t removed = rbtree_erase_range(t, lo, lo + (key_t)k - 1);
+    const rbtree_stats stats = rbtree_get_stats(t);
+    assert(removed > 0 && stats.nodes_freed > 0 && stats.nodes_freed <= removed);
+    assert(stats.erase_fixup_calls == 0);
+    assert(stats.insert_fixup_calls <= 2 * height);
+    assert(stats.rotations_left + stats.rotations_right <= height);
+    test_color_constraint(t);
+  }
+  delete_rbtree(t);
+}
+#endif
+
 int main(void) {
   test_init();
   test_insert_single(1024);
@@ -379,5 +1513,46 @@ int main(void) {
   test_duplicate_values();
   test_multi_instance();
   test_find_erase_rand(10000, 17);
+  test_erase_keeps_nodes(2000, 59);
+  test_shrink(10000);
+  test_from_sorted_array(300);
+  test_insert_batch(1000, 10, 7);
+  test_insert_batch(1000, 500, 11);
+#ifndef RBTREE_COUNTED
+  // these walk one node per inserted key or expect update_key to keep the node
+  test_iterator(1000, 5);
+#endif
+  test_insert_hint(1000, 23);
+  test_minmax_cached(500, 29);
+  test_to_array_page(1000, 1, 13);
+  test_to_array_page(1000, 7, 19);
+  test_insert_unique(1000, 47);
+  test_find_batch(2000, 71);
+#ifdef RBTREE_ORDER_STATS
+  test_order_statistics(2000, 3);
+#endif
+#ifndef RBTREE_COUNTED
+  test_priority_queue(2000, 31);
+#endif
+  test_erase_range(3000, 37);
+#ifdef RBTREE_ORDER_STATS
+  test_split_join(4000, 41);
+  test_shrink_after_split(10000);
+#endif
+  test_join(1000, 83);
+#ifndef RBTREE_COUNTED
+  test_node_handles(2000, 89);
+#endif
+  test_union_copy(200, 3);
+  test_set_operations(3000, 43);
+#ifdef RBTREE_COUNTED
+  test_counted(4000, 53);
+#endif
+#if defined(RBTREE_STATS) && !defined(RBTREE_COUNTED)
+  test_stats(5000);
+#endif
+#ifdef RBTREE_STATS
+  test_erase_range_cost(1 << 17);
+#endif
   printf("Passed all tests!\n");
 }